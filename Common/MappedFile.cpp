@@ -0,0 +1,71 @@
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+auto MappedFile::open(const std::string& filename) -> bool {
+    close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void*  view    = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) { CloseHandle(mapping); }
+        CloseHandle(file);
+        return false;
+    }
+    file_    = file;
+    mapping_ = mapping;
+    data_    = static_cast<const uint8_t*>(view);
+    size_    = size_t(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) { UnmapViewOfFile(data_); }
+    if (mapping_ != nullptr) { CloseHandle(mapping_); }
+    if (file_ != nullptr) { CloseHandle(file_); }
+    data_    = nullptr;
+    size_    = 0;
+    file_    = nullptr;
+    mapping_ = nullptr;
+}
+#else
+auto MappedFile::open(const std::string& filename) -> bool {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后不再需要文件描述符
+    ::close(fd);
+    if (view == MAP_FAILED) { return false; }
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = size_t(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) { munmap(const_cast<uint8_t*>(data_), size_); }
+    data_ = nullptr;
+    size_ = 0;
+}
+#endif
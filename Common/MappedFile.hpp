@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 只读的内存映射文件，内容在首次访问时按页读入
+class MappedFile {
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& filename) { open(filename); }
+    MappedFile(const MappedFile&)                    = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+    ~MappedFile() { close(); }
+
+    // 文件不存在、为空或无法映射时返回 false
+    auto open(const std::string& filename) -> bool;
+    void close();
+
+    auto isOpen() const -> bool { return data_ != nullptr; }
+    auto data() const -> const uint8_t* { return data_; }
+    auto size() const -> size_t { return size_; }
+
+  private:
+    const uint8_t* data_ = nullptr;
+    size_t         size_ = 0;
+#ifdef _WIN32
+    void* file_    = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
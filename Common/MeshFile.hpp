@@ -0,0 +1,140 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// 二进制网格文件（.mesh）
+//
+// 文件头之后依次是顶点位置、法线、纹理坐标与 u32 三角形索引，各段按 16 字节对齐。
+// 顶点已经去重，三个属性数组长度相同。打开时整个文件映射到内存，各数组直接指向映射，
+// 加载只需要缺页读入，不需要解析。由 meshconv 工具从 OBJ 转换得到。
+class MeshFile {
+  public:
+    struct Float3 {
+        float x, y, z;
+    };
+    struct Float2 {
+        float x, y;
+    };
+
+    // 映射文件并校验文件头与各段的范围
+    auto open(const std::string& filename) -> bool {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(filename) || file->size() < sizeof(Header)) { return false; }
+        Header header{};
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != VERSION || header.indexCount % 3 != 0) {
+            return false;
+        }
+        const uint64_t sizes[4] = {sizeof(Float3), sizeof(Float3), sizeof(Float2),
+                                   sizeof(uint32_t)};
+        for (int s = 0; s < 4; ++s) {
+            uint64_t count = s < 3 ? header.vertexCount : header.indexCount;
+            if (header.offsets[s] % ALIGN != 0 || header.offsets[s] > file->size() ||
+                count > (file->size() - header.offsets[s]) / sizes[s]) {
+                return false;
+            }
+        }
+        const uint8_t* base = file->data();
+        positions_ = {reinterpret_cast<const Float3*>(base + header.offsets[0]),
+                      header.vertexCount};
+        normals_   = {reinterpret_cast<const Float3*>(base + header.offsets[1]),
+                      header.vertexCount};
+        texCoords_ = {reinterpret_cast<const Float2*>(base + header.offsets[2]),
+                      header.vertexCount};
+        indices_   = {reinterpret_cast<const uint32_t*>(base + header.offsets[3]),
+                      header.indexCount};
+        for (uint32_t index : indices_) {
+            if (index >= header.vertexCount) { return false; }
+        }
+        file_ = std::move(file);
+        return true;
+    }
+
+    auto positions() const -> std::span<const Float3> { return positions_; }
+    auto normals() const -> std::span<const Float3> { return normals_; }
+    auto texCoords() const -> std::span<const Float2> { return texCoords_; }
+    // 每三个索引构成一个三角形
+    auto indices() const -> std::span<const uint32_t> { return indices_; }
+    auto triangleCount() const -> size_t { return indices_.size() / 3; }
+
+    // 写出网格文件，三个属性数组长度必须相同
+    static auto write(const std::string& filename, const std::vector<Float3>& positions,
+                      const std::vector<Float3>& normals, const std::vector<Float2>& texCoords,
+                      const std::vector<uint32_t>& indices) -> bool {
+        if (normals.size() != positions.size() || texCoords.size() != positions.size()) {
+            return false;
+        }
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.version     = VERSION;
+        header.vertexCount = positions.size();
+        header.indexCount  = indices.size();
+        const void* data[4]  = {positions.data(), normals.data(), texCoords.data(),
+                                indices.data()};
+        uint64_t    bytes[4] = {positions.size() * sizeof(Float3), normals.size() * sizeof(Float3),
+                                texCoords.size() * sizeof(Float2),
+                                indices.size() * sizeof(uint32_t)};
+        uint64_t    offset   = alignUp(sizeof(header));
+        for (int s = 0; s < 4; ++s) {
+            header.offsets[s] = offset;
+            offset            = alignUp(offset + bytes[s]);
+        }
+
+        FILE* fp = fopen(filename.c_str(), "wb");
+        if (fp == nullptr) { return false; }
+        bool                 ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        std::vector<uint8_t> padding(ALIGN, 0);
+        uint64_t             written = sizeof(header);
+        for (int s = 0; s < 4 && ok; ++s) {
+            ok = fwrite(padding.data(), 1, header.offsets[s] - written, fp) ==
+                     header.offsets[s] - written &&
+                 fwrite(data[s], 1, bytes[s], fp) == bytes[s];
+            written = header.offsets[s] + bytes[s];
+        }
+        return fclose(fp) == 0 && ok;
+    }
+
+  private:
+    static constexpr char     MAGIC[8] = {'R', 'T', 'M', 'E', 'S', 'H', '\0', '\0'};
+    static constexpr uint32_t VERSION  = 1;
+    static constexpr uint64_t ALIGN    = 16;
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t pad;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t offsets[4]; // 位置、法线、纹理坐标、索引
+    };
+
+    static auto alignUp(uint64_t offset) -> uint64_t {
+        return (offset + ALIGN - 1) / ALIGN * ALIGN;
+    }
+
+    std::shared_ptr<MappedFile> file_;
+    std::span<const Float3>     positions_;
+    std::span<const Float3>     normals_;
+    std::span<const Float2>     texCoords_;
+    std::span<const uint32_t>   indices_;
+};
+
+// 同名的 .mesh 文件存在且不比 OBJ 旧时返回它，否则原样返回 OBJ 路径。
+// OBJ 修改之后 .mesh 视为过期，需要重新运行 meshconv
+inline auto preferMeshFile(const std::string& objPath) -> std::string {
+    std::error_code error;
+    std::string     meshPath = std::filesystem::path(objPath).replace_extension(".mesh").string();
+    auto            meshTime = std::filesystem::last_write_time(meshPath, error);
+    if (error) { return objPath; }
+    auto objTime = std::filesystem::last_write_time(objPath, error);
+    return error || meshTime >= objTime ? meshPath : objPath;
+}
@@ -1,3 +1,4 @@
+#include "MeshFile.hpp"
 #include "OBJ_Loader.h"
 #include "Shader.hpp"
 #include "Texture.hpp"
@@ -383,8 +384,29 @@ auto main(int argc, const char** argv) -> int {
     objl::Loader Loader;
     std::string  obj_path = "res/models/spot/";
 
+    // 优先加载转换好的二进制网格，顶点直接来自映射的文件
+    std::string mesh_path = preferMeshFile("res/models/spot/spot_triangulated_good.obj");
+    MeshFile    mesh_file;
+    if (mesh_path.ends_with(".mesh") && mesh_file.open(mesh_path)) {
+        auto positions  = mesh_file.positions();
+        auto normals    = mesh_file.normals();
+        auto tex_coords = mesh_file.texCoords();
+        auto indices    = mesh_file.indices();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            auto* t = new Triangle();
+            for (int j = 0; j < 3; j++) {
+                uint32_t k = indices[i + j];
+                t->setVertex(j, Vector4f(positions[k].x, positions[k].y, positions[k].z, 1.0));
+                t->setNormal(j, Vector3f(normals[k].x, normals[k].y, normals[k].z));
+                t->setTexCoord(j, Vector2f(tex_coords[k].x, tex_coords[k].y));
+            }
+            TriangleList.push_back(t);
+        }
+    }
+
     // Load .obj File
-    bool loadout = Loader.LoadFile("res/models/spot/spot_triangulated_good.obj");
+    bool loadout = TriangleList.empty() &&
+                   Loader.LoadFile("res/models/spot/spot_triangulated_good.obj");
     for (auto mesh : Loader.LoadedMeshes) {
         for (int i = 0; i < mesh.Vertices.size(); i += 3) {
             auto* t = new Triangle();
@@ -35,6 +35,9 @@ target("03", function()
     set_extension(".exe")
     set_default(true)
     add_files("src/*.cpp")
+    -- 各作业共用的网格文件读写
+    add_files("../Common/*.cpp")
+    add_includedirs("../Common")
 
     add_packages("eigen3", "opencv4")
     add_packages("libpng", "libwebp", "libjpeg-turbo", "liblzma", "tiff", "zlib")
@@ -3,10 +3,12 @@
 #include "BVH.hpp"
 #include "Intersection.hpp"
 #include "Material.hpp"
+#include "MeshFile.hpp"
 #include "OBJ_Loader.hpp"
 #include "Object.hpp"
 #include <array>
 #include <cassert>
+#include <filesystem>
 
 inline auto rayTriangleIntersect(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
                                  const Vector3f& orig, const Vector3f& dir, float& tnear, float& u,
@@ -65,11 +67,35 @@ class Triangle : public Object {
 class MeshTriangle : public Object {
   public:
     MeshTriangle(const std::string& filename) {
-        objl::Loader loader;
-        loader.LoadFile(filename);
-
-        assert(loader.LoadedMeshes.size() == 1);
-        auto mesh = loader.LoadedMeshes[0];
+        // 每个三角形的三个顶点，来自转换好的二进制网格或 OBJ
+        std::vector<std::array<Vector3f, 3>> faces;
+        MeshFile                             meshFile;
+        if (filename.ends_with(".mesh") && meshFile.open(filename)) {
+            auto positions = meshFile.positions();
+            auto indices   = meshFile.indices();
+            faces.resize(meshFile.triangleCount());
+            for (size_t i = 0; i < indices.size(); ++i) {
+                const auto& p       = positions[indices[i]];
+                faces[i / 3][i % 3] = Vector3f(p.x, p.y, p.z);
+            }
+        } else {
+            // 二进制网格无法打开时退回到同名的 OBJ
+            std::string objFile = filename;
+            if (filename.ends_with(".mesh")) {
+                fprintf(stderr, "Cannot load mesh %s, using OBJ\n", filename.c_str());
+                objFile = std::filesystem::path(filename).replace_extension(".obj").string();
+            }
+            objl::Loader loader;
+            loader.LoadFile(objFile);
+
+            assert(loader.LoadedMeshes.size() == 1);
+            const auto& mesh = loader.LoadedMeshes[0];
+            faces.resize(mesh.Vertices.size() / 3);
+            for (size_t i = 0; i < faces.size() * 3; ++i) {
+                const auto& p       = mesh.Vertices[i].Position;
+                faces[i / 3][i % 3] = Vector3f(p.X, p.Y, p.Z);
+            }
+        }
 
         Vector3f min_vert =
             Vector3f{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
@@ -77,13 +103,10 @@ class MeshTriangle : public Object {
         Vector3f max_vert = Vector3f{-std::numeric_limits<float>::infinity(),
                                      -std::numeric_limits<float>::infinity(),
                                      -std::numeric_limits<float>::infinity()};
-        for (int i = 0; i < mesh.Vertices.size(); i += 3) {
+        for (const auto& face : faces) {
             std::array<Vector3f, 3> face_vertices;
             for (int j = 0; j < 3; j++) {
-                auto vert =
-                    Vector3f(mesh.Vertices[i + j].Position.X, mesh.Vertices[i + j].Position.Y,
-                             mesh.Vertices[i + j].Position.Z) *
-                    60.f;
+                auto vert        = face[j] * 60.f;
                 face_vertices[j] = vert;
 
                 min_vert = Vector3f(std::min(min_vert.x, vert.x), std::min(min_vert.y, vert.y),
@@ -1,3 +1,4 @@
+#include "MeshFile.hpp"
 #include "Renderer.hpp"
 #include "Scene.hpp"
 #include "Triangle.hpp"
@@ -11,7 +12,7 @@
 auto main(int argc, char** argv) -> int {
     Scene scene(1280, 960);
 
-    MeshTriangle bunny("res/models/bunny/bunny.obj");
+    MeshTriangle bunny(preferMeshFile("res/models/bunny/bunny.obj"));
 
     scene.Add(&bunny);
     scene.Add(std::make_unique<Light>(Vector3f(-20, 70, 20), 1));
@@ -26,6 +26,9 @@ target("06", function()
     set_extension(".exe")
     set_default(true)
     add_files("src/*.cpp")
+    -- 各作业共用的网格文件读写
+    add_files("../Common/*.cpp")
+    add_includedirs("../Common")
 
     set_rundir("./")
     set_runargs()
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+// Walker 别名表：按给定权重以 O(1) 时间抽取下标
+//
+// n 个下标各占一个等宽的桶，桶 i 以概率 q 返回 i 本身，否则返回其别名。
+// 用 Vose 的方法构建，复杂度 O(n)。
+class AliasTable {
+  public:
+    AliasTable() = default;
+
+    explicit AliasTable(const std::vector<float>& weights) : bins_(weights.size()) {
+        double sum = 0;
+        for (float w : weights) { sum += std::max(w, 0.F); }
+        if (bins_.empty() || sum <= 0) {
+            bins_.clear();
+            return;
+        }
+
+        auto                n = int(bins_.size());
+        std::vector<int>    small;
+        std::vector<int>    large;
+        std::vector<double> scaled(n);
+        for (int i = 0; i < n; ++i) {
+            bins_[i].pmf = float(std::max(weights[i], 0.F) / sum);
+            scaled[i]    = std::max(weights[i], 0.F) / sum * n;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back();
+            int l = large.back();
+            small.pop_back();
+            large.pop_back();
+            bins_[s].q     = float(scaled[s]);
+            bins_[s].alias = l;
+            scaled[l]      = scaled[l] + scaled[s] - 1;
+            (scaled[l] < 1 ? small : large).push_back(l);
+        }
+        // 剩下的桶因舍入误差与 1 略有差别，直接取 1
+        for (int i : small) { bins_[i].q = 1; }
+        for (int i : large) { bins_[i].q = 1; }
+    }
+
+    auto size() const -> int { return int(bins_.size()); }
+    auto empty() const -> bool { return bins_.empty(); }
+    auto pmf(int i) const -> float { return bins_[i].pmf; }
+
+    // 用一个 [0, 1) 均匀随机数选出下标，同时给出其概率
+    auto sample(float u, float& pmf) const -> int {
+        float x    = u * float(bins_.size());
+        int   i    = std::min(int(x), int(bins_.size()) - 1);
+        float frac = x - float(i);
+        int   k    = frac < bins_[i].q ? i : bins_[i].alias;
+        pmf        = bins_[k].pmf;
+        return k;
+    }
+
+  private:
+    struct Bin {
+        float q     = 1; // 返回 i 本身的概率
+        int   alias = 0;
+        float pmf   = 0; // 下标 i 被选中的概率
+    };
+    std::vector<Bin> bins_;
+};
@@ -1,135 +1,540 @@
 #include "BVH.hpp"
+#include "BVHCache.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <limits>
+#include <omp.h>
 
-BVHAccel::BVHAccel(std::vector<Object*> p, int maxPrimsInNode, SplitMethod splitMethod)
-    : maxPrimsInNode(std::min(255, maxPrimsInNode)), splitMethod(splitMethod),
-      primitives(std::move(p)) {
-    time_t start;
-    time_t stop;
-    time(&start);
+struct BVHPrimitiveInfo {
+    BVHPrimitiveInfo() = default;
+    BVHPrimitiveInfo(size_t primitiveNumber, const Bounds3& bounds)
+        : primitiveNumber(primitiveNumber), bounds(bounds),
+          centroid(0.5F * bounds.pMin + 0.5F * bounds.pMax) {}
+    size_t   primitiveNumber{};
+    Bounds3  bounds;
+    Vector3f centroid;
+};
+
+struct BVHBuildNode {
+    Bounds3                       bounds;
+    std::unique_ptr<BVHBuildNode> children[2];
+    int                           splitAxis = 0, firstPrimOffset = 0, nPrimitives = 0;
+
+    void InitLeaf(int first, int n, const Bounds3& b) {
+        firstPrimOffset = first;
+        nPrimitives     = n;
+        bounds          = b;
+    }
+    void InitInterior(int axis, std::unique_ptr<BVHBuildNode> c0,
+                      std::unique_ptr<BVHBuildNode> c1) {
+        bounds      = Union(c0->bounds, c1->bounds);
+        children[0] = std::move(c0);
+        children[1] = std::move(c1);
+        splitAxis   = axis;
+        nPrimitives = 0;
+    }
+};
+
+// SAH 中相对于一次图元求交的节点遍历代价
+constexpr float TRAVERSAL_COST = 0.125F;
+
+namespace {
+    // 每个轴量化为 10 位，三轴交错得到 30 位 Morton 码。码相同的图元由中位数划分，
+    // 更长的码只会让排序的趟数与数据量加倍
+    constexpr int MORTON_BITS = 10;
+    // 图元数多于此时，两个子树作为并行任务生成
+    constexpr int LBVH_TASK_SIZE = 4096;
+    // 基数排序每趟处理的位数
+    constexpr int RADIX_BITS = 8;
+    constexpr const char* SPLIT_METHOD_NAMES[] = {"naive", "SAH", "LBVH"};
+
+    struct MortonPrimitive {
+        uint32_t code;
+        int32_t  index;
+    };
+
+    // 把 10 位整数的各位之间插入两个 0
+    auto expandBits(uint32_t v) -> uint32_t {
+        v &= (1U << MORTON_BITS) - 1;
+        v  = (v | v << 16) & 0x030000FFU;
+        v  = (v | v << 8) & 0x0300F00FU;
+        v  = (v | v << 4) & 0x030C30C3U;
+        v  = (v | v << 2) & 0x09249249U;
+        return v;
+    }
+
+    // 第 b 位所在的轴，x 位于最高位
+    auto mortonAxis(int bit) -> int { return 2 - bit % 3; }
+
+    // LSD 基数排序。每趟中各段并行统计桶的大小，前缀和之后各段并行写到各自的位置，
+    // 所有图元都落在同一个桶的趟直接跳过
+    void radixSort(std::vector<MortonPrimitive>& prims) {
+        constexpr int BUCKETS = 1 << RADIX_BITS;
+        const size_t  n       = prims.size();
+        const int     nBlocks =
+            int(std::clamp(n / LBVH_TASK_SIZE, size_t(1), size_t(omp_get_max_threads())));
+        std::vector<MortonPrimitive>             sorted(n);
+        std::vector<std::array<size_t, BUCKETS>> offsets(nBlocks);
+        auto blockBegin = [&](int b) { return n * size_t(b) / size_t(nBlocks); };
+        for (int shift = 0; shift < 3 * MORTON_BITS; shift += RADIX_BITS) {
+#pragma omp parallel for schedule(static, 1)
+            for (int b = 0; b < nBlocks; ++b) {
+                offsets[b].fill(0);
+                for (size_t i = blockBegin(b); i < blockBegin(b + 1); ++i) {
+                    offsets[b][(prims[i].code >> shift) & (BUCKETS - 1)]++;
+                }
+            }
+            // 按桶优先、段其次的顺序求前缀和，得到每段每个桶的起点
+            size_t sum  = 0;
+            bool   skip = false;
+            for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+                size_t start = sum;
+                for (int b = 0; b < nBlocks; ++b) {
+                    size_t count       = offsets[b][bucket];
+                    offsets[b][bucket] = sum;
+                    sum               += count;
+                }
+                skip = skip || sum - start == n;
+            }
+            if (skip) { continue; }
+#pragma omp parallel for schedule(static, 1)
+            for (int b = 0; b < nBlocks; ++b) {
+                for (size_t i = blockBegin(b); i < blockBegin(b + 1); ++i) {
+                    sorted[offsets[b][(prims[i].code >> shift) & (BUCKETS - 1)]++] = prims[i];
+                }
+            }
+            prims.swap(sorted);
+        }
+    }
+
+    // 生成 prims[start, end) 的子树，这些图元的 Morton 码在 bit 以上的各位都相同。
+    // 叶子引用排序后的连续区间，因此各子树互不依赖，可以并行生成
+    auto emitLBVH(const std::vector<BVHPrimitiveInfo>& primitiveInfo,
+                  const std::vector<MortonPrimitive>& prims, int start, int end, int bit,
+                  int maxPrimsInNode, std::atomic<int>& totalNodes)
+        -> std::unique_ptr<BVHBuildNode> {
+        auto node = std::make_unique<BVHBuildNode>();
+        totalNodes++;
+        if (end - start <= maxPrimsInNode) {
+            Bounds3 bounds;
+            for (int i = start; i < end; ++i) {
+                bounds = Union(bounds, primitiveInfo[prims[i].index].bounds);
+            }
+            node->InitLeaf(start, end - start, bounds);
+            return node;
+        }
+
+        // 跳过区间内相同的位，在第一个为 1 的位置划分。所有位都相同时从中间划分
+        uint32_t first = prims[start].code;
+        uint32_t last  = prims[end - 1].code;
+        while (bit >= 0 && ((first ^ last) >> bit & 1) == 0) { --bit; }
+        int mid  = (start + end) / 2;
+        int axis = 0;
+        if (bit >= 0) {
+            mid  = int(std::partition_point(prims.begin() + start, prims.begin() + end,
+                                            [bit](const MortonPrimitive& p) {
+                                                return (p.code >> bit & 1) == 0;
+                                            }) -
+                       prims.begin());
+            axis = mortonAxis(bit);
+        }
+
+        std::unique_ptr<BVHBuildNode> left;
+        std::unique_ptr<BVHBuildNode> right;
+        if (end - start > LBVH_TASK_SIZE) {
+#pragma omp task default(shared)
+            left = emitLBVH(primitiveInfo, prims, start, mid, bit - 1, maxPrimsInNode, totalNodes);
+            right = emitLBVH(primitiveInfo, prims, mid, end, bit - 1, maxPrimsInNode, totalNodes);
+#pragma omp taskwait
+        } else {
+            left  = emitLBVH(primitiveInfo, prims, start, mid, bit - 1, maxPrimsInNode, totalNodes);
+            right = emitLBVH(primitiveInfo, prims, mid, end, bit - 1, maxPrimsInNode, totalNodes);
+        }
+        node->InitInterior(axis, std::move(left), std::move(right));
+        return node;
+    }
+} // namespace
+
+BVHAccel::BVHAccel(std::vector<Object*> p, int maxPrimsInNode, SplitMethod splitMethod,
+                   int nBuckets, SimdLevel simd)
+    : maxPrimsInNode(std::clamp(maxPrimsInNode, 1, 255)), splitMethod(splitMethod),
+      nBuckets(std::max(2, nBuckets)), simd(simd), primitives(std::move(p)) {
+    auto start = std::chrono::steady_clock::now();
     if (primitives.empty()) { return; }
 
-    root = recursiveBuild(primitives);
+    // 图元全部为三角形时叶子会被打包成 SIMD 块，SAH 按块计算求交代价
+    std::vector<std::array<Vector3f, 3>> vertices(primitives.size());
+    packedTriangles = true;
+    for (size_t i = 0; i < primitives.size() && packedTriangles; ++i) {
+        packedTriangles = primitives[i]->getVertices(vertices[i]);
+    }
+    if (packedTriangles) { leafWidth = simdWidth(simd); }
+
+    std::vector<Bounds3> bounds(primitives.size());
+    for (size_t i = 0; i < primitives.size(); ++i) { bounds[i] = primitives[i]->getBounds(); }
+    auto                 order = build(bounds);
+    std::vector<Object*> orderedPrims(primitives.size());
+    for (size_t i = 0; i < order.size(); ++i) { orderedPrims[i] = primitives[order[i]]; }
+    primitives.swap(orderedPrims);
+
+    if (packedTriangles) {
+        for (size_t i = 0; i < primitives.size(); ++i) { primitives[i]->getVertices(vertices[i]); }
+        visitWideBVH([&](auto& wide) {
+            wide.packTriangles(vertices);
+            return true;
+        });
+    }
+
+    areaCdf.reserve(primitives.size());
+    float areaSum = 0;
+    for (auto* prim : primitives) { areaCdf.push_back(areaSum += prim->getArea()); }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    printf("\rBVH Generation complete (%s): %zu primitives, %zu nodes, SAH cost %.2f\n",
+           SPLIT_METHOD_NAMES[int(splitMethod)], primitives.size(), nodes.size(), SAHCost());
+    printf("BVH%d: %zu nodes\n", wideBVH8 ? 8 : 4,
+           wideBVH8 ? wideBVH8->nodeCount() : wideBVH4->nodeCount());
+    printf("Time Taken: %.2f ms\n\n", elapsed.count());
+}
+
+BVHAccel::BVHAccel(const std::vector<std::array<Vector3f, 3>>& triangles, Object* owner,
+                   int maxPrimsInNode, SplitMethod splitMethod, int nBuckets, SimdLevel simd)
+    : maxPrimsInNode(std::clamp(maxPrimsInNode, 1, 255)), splitMethod(splitMethod),
+      nBuckets(std::max(2, nBuckets)), simd(simd), owner(owner) {
+    auto start = std::chrono::steady_clock::now();
+    if (triangles.empty()) { return; }
+    packedTriangles = true;
+    leafWidth       = simdWidth(simd);
+
+    std::vector<Bounds3> bounds(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        bounds[i] = Union(Bounds3(triangles[i][0], triangles[i][1]), triangles[i][2]);
+    }
+    primitiveIds = build(bounds);
+
+    // 块中记录三角形的下标，命中后直接由 owner 的顶点缓冲得到表面信息
+    std::vector<std::array<Vector3f, 3>> vertices(triangles.size());
+    for (size_t i = 0; i < vertices.size(); ++i) { vertices[i] = triangles[primitiveIds[i]]; }
+    visitWideBVH([&](auto& wide) {
+        wide.packTriangles(vertices, primitiveIds);
+        return true;
+    });
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    printf("\rBVH Generation complete (%s): %zu primitives, %zu nodes, SAH cost %.2f\n",
+           SPLIT_METHOD_NAMES[int(splitMethod)], triangles.size(), nodes.size(), SAHCost());
+    printf("BVH%d: %zu nodes\n", wideBVH8 ? 8 : 4,
+           wideBVH8 ? wideBVH8->nodeCount() : wideBVH4->nodeCount());
+    printf("Time Taken: %.2f ms\n\n", elapsed.count());
+}
+
+BVHAccel::BVHAccel(Object* owner, const BVHCache& cache, int maxPrimsInNode,
+                   SplitMethod splitMethod, int nBuckets, SimdLevel simd)
+    : maxPrimsInNode(std::clamp(maxPrimsInNode, 1, 255)), splitMethod(splitMethod),
+      nBuckets(std::max(2, nBuckets)), simd(simd), owner(owner) {
+    auto start = std::chrono::steady_clock::now();
+    // 缓存只为三角形网格生成，叶子总是打包好的三角形块
+    packedTriangles = true;
+    leafWidth       = cache.width();
+    primitiveIds.assign(cache.order().begin(), cache.order().end());
+    nodes.assign(cache.nodes().begin(), cache.nodes().end());
+    // 多叉 BVH 直接引用映射的文件，不复制
+    if (cache.width() == 8) {
+        wideBVH8 = std::make_unique<WideBVH<8>>(cache.wideNodes<8>(), cache.blocks<8>(), simd,
+                                                cache.storage());
+    } else {
+        wideBVH4 = std::make_unique<WideBVH<4>>(cache.wideNodes<4>(), cache.blocks<4>(), simd,
+                                                cache.storage());
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    printf("\rBVH loaded from cache: %zu primitives, %zu nodes\n", primitiveIds.size(),
+           nodes.size());
+    printf("BVH%d: %zu nodes\n", wideBVH8 ? 8 : 4,
+           wideBVH8 ? wideBVH8->nodeCount() : wideBVH4->nodeCount());
+    printf("Time Taken: %.2f ms\n\n", elapsed.count());
+}
+
+BVHAccel::~BVHAccel() = default;
+
+auto BVHAccel::WorldBound() const -> Bounds3 {
+    return nodes.empty() ? Bounds3() : nodes[0].bounds;
+}
+
+auto BVHAccel::build(const std::vector<Bounds3>& bounds) -> std::vector<int32_t> {
+    std::vector<BVHPrimitiveInfo> primitiveInfo(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i) { primitiveInfo[i] = {i, bounds[i]}; }
+
+    int                  totalNodes = 0;
+    std::vector<int32_t> orderedPrims;
+    orderedPrims.reserve(bounds.size());
+    std::unique_ptr<BVHBuildNode> root;
+    if (splitMethod == SplitMethod::LBVH) {
+        root = buildLBVH(primitiveInfo, totalNodes, orderedPrims);
+    } else {
+        root = recursiveBuild(primitiveInfo, 0, int(bounds.size()), totalNodes, orderedPrims);
+    }
+
+    // 展平为深度优先顺序的数组，构建用的树随之释放
+    nodes.resize(totalNodes);
+    int offset = 0;
+    flattenBVHTree(root.get(), offset);
+    assert(totalNodes == offset);
 
-    time(&stop);
-    double diff = difftime(stop, start);
-    int    hrs  = (int)diff / 3600;
-    int    mins = ((int)diff / 60) - (hrs * 60);
-    int    secs = (int)diff - (hrs * 3600) - (mins * 60);
+    // 遍历使用合并后的多叉 BVH，宽度与 SIMD 指令集匹配
+    if (simd == SimdLevel::AVX2) {
+        wideBVH8 = std::make_unique<WideBVH<8>>(nodes, simd);
+    } else {
+        wideBVH4 = std::make_unique<WideBVH<4>>(nodes, simd);
+    }
+    return orderedPrims;
+}
+
+auto BVHAccel::buildLBVH(const std::vector<BVHPrimitiveInfo>& primitiveInfo, int& totalNodes,
+                         std::vector<int32_t>& orderedPrims) -> std::unique_ptr<BVHBuildNode> {
+    // 质心在所有质心的包围盒中量化为整数坐标
+    Bounds3 centroidBounds;
+    for (const auto& info : primitiveInfo) {
+        centroidBounds = Union(centroidBounds, info.centroid);
+    }
+    const int                    n = int(primitiveInfo.size());
+    std::vector<MortonPrimitive> prims(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        uint32_t code = 0;
+        for (int a = 0; a < 3; ++a) {
+            float lo     = float(centroidBounds.pMin[a]);
+            float extent = float(centroidBounds.pMax[a]) - lo;
+            float offset = extent > 0 ? (float(primitiveInfo[i].centroid[a]) - lo) / extent : 0.F;
+            auto  q      = uint32_t(std::clamp(offset * float(1 << MORTON_BITS), 0.F,
+                                               float((1 << MORTON_BITS) - 1)));
+            code        |= expandBits(q) << (2 - a);
+        }
+        prims[i] = {code, int32_t(i)};
+    }
+    radixSort(prims);
 
-    printf("\rBVH Generation complete: \nTime Taken: %i hrs, %i mins, %i secs\n\n", hrs, mins,
-           secs);
+    // 叶子即排序后的连续区间，图元顺序就是排序结果
+    orderedPrims.resize(n);
+    for (int i = 0; i < n; ++i) { orderedPrims[i] = prims[i].index; }
+    std::atomic<int>              nodeCount = 0;
+    std::unique_ptr<BVHBuildNode> root;
+#pragma omp parallel
+#pragma omp single
+    root = emitLBVH(primitiveInfo, prims, 0, n, 3 * MORTON_BITS - 1, maxPrimsInNode, nodeCount);
+    totalNodes = nodeCount;
+    return root;
 }
 
-auto BVHAccel::recursiveBuild(std::vector<Object*> objects) -> BVHBuildNode* {
-    BVHBuildNode* node = new BVHBuildNode();
+auto BVHAccel::recursiveBuild(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end,
+                              int& totalNodes, std::vector<int32_t>& orderedPrims)
+    -> std::unique_ptr<BVHBuildNode> {
+    auto node = std::make_unique<BVHBuildNode>();
+    totalNodes++;
 
     // Compute bounds of all primitives in BVH node
     Bounds3 bounds;
-    for (auto& object : objects) { bounds = Union(bounds, object->getBounds()); }
-    if (objects.size() == 1) {
+    for (int i = start; i < end; ++i) { bounds = Union(bounds, primitiveInfo[i].bounds); }
+    int  nPrimitives = end - start;
+    auto createLeaf  = [&] {
+        int firstPrimOffset = int(orderedPrims.size());
+        for (int i = start; i < end; ++i) {
+            orderedPrims.push_back(int32_t(primitiveInfo[i].primitiveNumber));
+        }
+        node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
+        return std::move(node);
+    };
+    if (nPrimitives == 1) {
         // Create leaf _BVHBuildNode_
-        node->bounds = objects[0]->getBounds();
-        node->object = objects[0];
-        node->left   = nullptr;
-        node->right  = nullptr;
-        node->area   = objects[0]->getArea();
-        return node;
-    }
-    if (objects.size() == 2) {
-        node->left  = recursiveBuild(std::vector{objects[0]});
-        node->right = recursiveBuild(std::vector{objects[1]});
-
-        node->bounds = Union(node->left->bounds, node->right->bounds);
-        node->area   = node->left->area + node->right->area;
-        return node;
+        return createLeaf();
     }
 
     Bounds3 centroidBounds;
-    for (auto& object : objects) {
-        centroidBounds = Union(centroidBounds, object->getBounds().Centroid());
+    for (int i = start; i < end; ++i) {
+        centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
     }
     int dim = centroidBounds.maxExtent();
-    switch (dim) {
-        case 0:
-            std::sort(objects.begin(), objects.end(), [](auto f1, auto f2) {
-                return f1->getBounds().Centroid().x < f2->getBounds().Centroid().x;
-            });
-            break;
-        case 1:
-            std::sort(objects.begin(), objects.end(), [](auto f1, auto f2) {
-                return f1->getBounds().Centroid().y < f2->getBounds().Centroid().y;
-            });
-            break;
-        case 2:
-            std::sort(objects.begin(), objects.end(), [](auto f1, auto f2) {
-                return f1->getBounds().Centroid().z < f2->getBounds().Centroid().z;
-            });
-            break;
-    }
-
-    auto beginning = objects.begin();
-    auto middling  = objects.begin() + (objects.size() / 2);
-    auto ending    = objects.end();
-
-    auto leftshapes  = std::vector<Object*>(beginning, middling);
-    auto rightshapes = std::vector<Object*>(middling, ending);
-
-    assert(objects.size() == (leftshapes.size() + rightshapes.size()));
-
-    node->left  = recursiveBuild(leftshapes);
-    node->right = recursiveBuild(rightshapes);
-
-    node->bounds = Union(node->left->bounds, node->right->bounds);
-    node->area   = node->left->area + node->right->area;
+    // 所有质心重合时无法再划分
+    if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) { return createLeaf(); }
+
+    int mid = (start + end) / 2;
+    if (splitMethod == SplitMethod::NAIVE || nPrimitives <= 2) {
+        // 按质心在 dim 轴上的中位数划分
+        if (nPrimitives <= maxPrimsInNode) { return createLeaf(); }
+        std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+                         [dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                             return a.centroid[dim] < b.centroid[dim];
+                         });
+    } else {
+        // 分桶 SAH：把质心沿 dim 轴投到 nBuckets 个桶中，在桶边界处选代价最小的划分
+        struct BucketInfo {
+            int     count = 0;
+            Bounds3 bounds;
+        };
+        std::vector<BucketInfo> buckets(nBuckets);
+        auto                    bucketOf = [&](const BVHPrimitiveInfo& pi) {
+            int b = int(float(nBuckets) * centroidBounds.Offset(pi.centroid)[dim]);
+            return std::min(b, nBuckets - 1);
+        };
+        for (int i = start; i < end; ++i) {
+            BucketInfo& bucket = buckets[bucketOf(primitiveInfo[i])];
+            bucket.count++;
+            bucket.bounds = Union(bucket.bounds, primitiveInfo[i].bounds);
+        }
+
+        // 从右向左累积，得到每个划分位置右侧的包围盒与图元数
+        std::vector<float> rightArea(nBuckets);
+        std::vector<int>   rightCount(nBuckets);
+        Bounds3            accBounds;
+        int                accCount = 0;
+        for (int i = nBuckets - 1; i > 0; --i) {
+            accBounds     = Union(accBounds, buckets[i].bounds);
+            accCount     += buckets[i].count;
+            rightArea[i]  = accCount > 0 ? float(accBounds.SurfaceArea()) : 0.F;
+            rightCount[i] = accCount;
+        }
+
+        // 从左向右扫描，第 i 个划分位置把桶 [0, i) 与 [i, nBuckets) 分开
+        float minCost      = std::numeric_limits<float>::infinity();
+        int   minCostSplit = 0;
+        float invArea      = 1.F / float(bounds.SurfaceArea());
+        accBounds          = Bounds3();
+        accCount           = 0;
+        for (int i = 1; i < nBuckets; ++i) {
+            accBounds  = Union(accBounds, buckets[i - 1].bounds);
+            accCount  += buckets[i - 1].count;
+            if (accCount == 0 || rightCount[i] == 0) { continue; }
+            float leftCost  = intersectCost(accCount) * float(accBounds.SurfaceArea());
+            float rightCost = intersectCost(rightCount[i]) * rightArea[i];
+            float cost      = TRAVERSAL_COST + (leftCost + rightCost) * invArea;
+            if (cost < minCost) {
+                minCost      = cost;
+                minCostSplit = i;
+            }
+        }
+
+        // 图元数不多且划分并不比直接作为叶子便宜时，生成叶子
+        float leafCost = intersectCost(nPrimitives);
+        if (nPrimitives <= maxPrimsInNode && leafCost <= minCost) { return createLeaf(); }
+
+        BVHPrimitiveInfo* pmid = std::partition(
+            &primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+            [&](const BVHPrimitiveInfo& pi) { return bucketOf(pi) < minCostSplit; });
+        mid = int(pmid - &primitiveInfo[0]);
+    }
+
+    node->InitInterior(dim, recursiveBuild(primitiveInfo, start, mid, totalNodes, orderedPrims),
+                       recursiveBuild(primitiveInfo, mid, end, totalNodes, orderedPrims));
 
     return node;
 }
 
-auto BVHAccel::Intersect(const Ray& ray) const -> Intersection {
-    Intersection isect;
-    if (root == nullptr) { return isect; }
-    isect = BVHAccel::getIntersection(root, ray);
-    return isect;
+auto BVHAccel::flattenBVHTree(const BVHBuildNode* node, int& offset) -> int {
+    LinearBVHNode& linearNode = nodes[offset];
+    linearNode.bounds         = node->bounds;
+    int myOffset              = offset++;
+    if (node->nPrimitives > 0) {
+        linearNode.primitivesOffset = node->firstPrimOffset;
+        linearNode.nPrimitives      = node->nPrimitives;
+    } else {
+        // Create interior flattened BVH node
+        linearNode.axis        = node->splitAxis;
+        linearNode.nPrimitives = 0;
+        flattenBVHTree(node->children[0].get(), offset);
+        linearNode.secondChildOffset = flattenBVHTree(node->children[1].get(), offset);
+    }
+    return myOffset;
 }
 
-auto BVHAccel::getIntersection(BVHBuildNode* node, const Ray& ray) const -> Intersection {
-    // DONE Traverse the BVH to find intersection
-    Intersection isect;
-
-    if (!node->bounds.IntersectP(
-            ray, ray.direction_inv,
-            std::array<int, 3>{ray.direction.x > 0, ray.direction.y > 0, ray.direction.z > 0})) {
-        return isect;
+auto BVHAccel::SAHCost() const -> float {
+    if (nodes.empty()) { return 0.F; }
+    float cost = 0;
+    for (const auto& node : nodes) {
+        float area  = float(node.bounds.SurfaceArea());
+        cost       += area * (node.nPrimitives > 0 ? intersectCost(node.nPrimitives) : TRAVERSAL_COST);
     }
+    float rootArea = float(nodes[0].bounds.SurfaceArea());
+    return rootArea > 0 ? cost / rootArea : cost;
+}
 
-    if (node->object != nullptr) { return node->object->getIntersection(ray); }
-
-    Intersection hit_left;
-    Intersection hit_right;
+template <typename F> auto BVHAccel::visitWideBVH(F&& f) const -> bool {
+    if (wideBVH8) { return f(*wideBVH8); }
+    return wideBVH4 != nullptr && f(*wideBVH4);
+}
 
-    hit_left  = getIntersection(node->left, ray);
-    hit_right = getIntersection(node->right, ray);
+auto BVHAccel::Intersect(const Ray& ray) const -> Intersection {
+    HitRecord hit;
+    return Intersect(ray, hit);
+}
 
-    return hit_left.distance <= hit_right.distance ? hit_left : hit_right;
+auto BVHAccel::Intersect(const Ray& ray, HitRecord& hit) const -> Intersection {
+    // DONE Traverse the BVH to find intersection
+    // 遍历时只维护精简的命中记录，完整的交点只对最终的最近交点构造一次
+    if (!ClosestHit(ray, hit)) { return {}; }
+    Object* object = hit.instance != nullptr ? hit.instance : hit.object;
+    return object->getIntersection(ray, hit);
 }
 
-void BVHAccel::getSample(BVHBuildNode* node, float p, Intersection& pos, float& pdf) {
-    if (node->left == nullptr || node->right == nullptr) {
-        node->object->Sample(pos, pdf);
-        pdf *= node->area;
-        return;
+auto BVHAccel::ClosestHit(const Ray& ray, HitRecord& hit) const -> bool {
+    float tMax = std::min(ray.t_max, hit.t);
+    if (packedTriangles) {
+        TriangleHit th;
+        th.t = tMax;
+        if (!visitWideBVH(
+                [&](auto& wide) { return wide.intersectTriangles(ray, ray.t_min, false, th); })) {
+            return false;
+        }
+        hit.t        = th.t;
+        hit.prim     = th.prim;
+        hit.uv       = Vector2f(th.u, th.v);
+        hit.object   = owner != nullptr ? owner : primitives[th.prim];
+        hit.instance = nullptr;
+        hit.root     = hit.object;
+        return true;
     }
-    if (p < node->left->area) {
-        getSample(node->left, p, pos, pdf);
-    } else {
-        getSample(node->right, p - node->left->area, pos, pdf);
+
+    // 叶子中的物体以当前最近交点的距离剪枝，命中后同步收紧遍历的 tMax
+    auto leaf = [&](int offset, int n, float& t) {
+        bool found = false;
+        for (int i = 0; i < n; ++i) {
+            if (primitives[offset + i]->closestHit(ray, hit)) {
+                hit.root = primitives[offset + i];
+                t        = hit.t;
+                found    = true;
+            }
+        }
+        return found;
+    };
+    return visitWideBVH([&](auto& wide) { return wide.traverse(WideRay(ray), tMax, false, leaf); });
+}
+
+auto BVHAccel::IntersectP(const Ray& ray) const -> bool {
+    // 遮挡查询：遇到 ray.t_max 之内的任意交点立即返回
+    if (packedTriangles) {
+        TriangleHit hit;
+        hit.t = ray.t_max;
+        return visitWideBVH(
+            [&](auto& wide) { return wide.intersectTriangles(ray, ray.t_min, true, hit); });
     }
+    auto leaf = [&](int offset, int n, float& /*tMax*/) {
+        for (int i = 0; i < n; ++i) {
+            if (primitives[offset + i]->intersect(ray)) { return true; }
+        }
+        return false;
+    };
+    return visitWideBVH(
+        [&](auto& wide) { return wide.traverse(WideRay(ray), ray.t_max, true, leaf); });
 }
 
-void BVHAccel::Sample(Intersection& pos, float& pdf) {
-    float p = std::sqrt(get_random_float()) * root->area;
-    getSample(root, p, pos, pdf);
-    pdf /= root->area;
+void BVHAccel::Sample(Intersection& pos, float& pdf) const {
+    // 按面积选取一个图元，再在其上均匀采样
+    float p   = get_random_float() * areaCdf.back();
+    auto  idx = std::min(size_t(std::upper_bound(areaCdf.begin(), areaCdf.end(), p) -
+                                areaCdf.begin()),
+                         areaCdf.size() - 1);
+    primitives[idx]->Sample(pos, pdf);
+    pdf *= primitives[idx]->getArea() / areaCdf.back();
 }
@@ -9,62 +9,101 @@
 #include "Intersection.hpp"
 #include "Object.hpp"
 #include "Ray.hpp"
+#include "WideBVH.hpp"
+#include <array>
 #include <atomic>
-#include <ctime>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+class BVHCache;
 struct BVHBuildNode;
 // BVHAccel Forward Declarations
 struct BVHPrimitiveInfo;
 
+// 展平后的 BVH 节点，按深度优先顺序存放，左孩子紧跟在父节点之后
+struct alignas(32) LinearBVHNode {
+    Bounds3 bounds;
+    union {
+        int primitivesOffset;  // leaf
+        int secondChildOffset; // interior
+    };
+    uint16_t nPrimitives; // 0 -> interior node
+    uint8_t  axis;        // interior node: xyz
+    uint8_t  pad[1];      // ensure 32 byte total size
+};
+static_assert(sizeof(LinearBVHNode) == 32);
+
 // BVHAccel Declarations
 inline int leafNodes, totalLeafNodes, totalPrimitives, interiorNodes;
 class BVHAccel {
 
   public:
     // BVHAccel Public Types
-    enum class SplitMethod { NAIVE, SAH };
+    // LBVH 按质心的 Morton 码排序后自顶向下按位划分，构建远快于 SAH，但树的质量较差
+    enum class SplitMethod { NAIVE, SAH, LBVH };
 
     // BVHAccel Public Methods
+    // simd 决定多叉 BVH 的宽度与遍历使用的指令集，不能高于 CPU 支持的级别
     BVHAccel(std::vector<Object*> p, int maxPrimsInNode = 1,
-             SplitMethod splitMethod = SplitMethod::NAIVE);
+             SplitMethod splitMethod = SplitMethod::NAIVE, int nBuckets = 12,
+             SimdLevel simd = detectSimdLevel());
+    // 三角形网格的 BVH，图元为 triangles 中的三角形。命中记录的 object 为 owner，
+    // prim 为三角形在 triangles 中的下标
+    BVHAccel(const std::vector<std::array<Vector3f, 3>>& triangles, Object* owner,
+             int maxPrimsInNode, SplitMethod splitMethod, int nBuckets = 12,
+             SimdLevel simd = detectSimdLevel());
+    // 从缓存加载已构建的三角形网格 BVH
+    BVHAccel(Object* owner, const BVHCache& cache, int maxPrimsInNode, SplitMethod splitMethod,
+             int nBuckets, SimdLevel simd);
     auto WorldBound() const -> Bounds3;
     ~BVHAccel();
 
-    auto          Intersect(const Ray& ray) const -> Intersection;
-    auto          getIntersection(BVHBuildNode* node, const Ray& ray) const -> Intersection;
-    auto          IntersectP(const Ray& ray) const -> bool;
-    BVHBuildNode* root;
+    auto Intersect(const Ray& ray) const -> Intersection;
+    // 同上，并给出最近交点的命中记录
+    auto Intersect(const Ray& ray, HitRecord& hit) const -> Intersection;
+    // 最近交点查询，只在 hit.t 之内寻找并更新精简的命中记录
+    auto ClosestHit(const Ray& ray, HitRecord& hit) const -> bool;
+    auto IntersectP(const Ray& ray) const -> bool;
 
     // BVHAccel Private Methods
-    auto recursiveBuild(std::vector<Object*> objects) -> BVHBuildNode*;
+    // 由各图元的包围盒构建 BVH 与多叉 BVH，返回按 BVH 顺序排列的图元下标
+    auto build(const std::vector<Bounds3>& bounds) -> std::vector<int32_t>;
+    auto recursiveBuild(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end,
+                        int& totalNodes, std::vector<int32_t>& orderedPrims)
+        -> std::unique_ptr<BVHBuildNode>;
+    // 并行计算 Morton 码、基数排序并生成层次结构
+    auto buildLBVH(const std::vector<BVHPrimitiveInfo>& primitiveInfo, int& totalNodes,
+                   std::vector<int32_t>& orderedPrims) -> std::unique_ptr<BVHBuildNode>;
+    auto flattenBVHTree(const BVHBuildNode* node, int& offset) -> int;
+    // 以根节点表面积归一化的 SAH 代价
+    auto SAHCost() const -> float;
+    // 与 n 个图元求交的代价，一个 SIMD 块内的图元同时求交
+    auto intersectCost(int n) const -> float { return float((n + leafWidth - 1) / leafWidth); }
+    // 以构建时选定宽度的多叉 BVH 调用 f
+    template <typename F> auto visitWideBVH(F&& f) const -> bool;
 
     // BVHAccel Private Data
-    const int            maxPrimsInNode;
-    const SplitMethod    splitMethod;
-    std::vector<Object*> primitives;
-
-    void getSample(BVHBuildNode* node, float p, Intersection& pos, float& pdf);
-    void Sample(Intersection& pos, float& pdf);
-};
-
-struct BVHBuildNode {
-    Bounds3       bounds;
-    BVHBuildNode* left;
-    BVHBuildNode* right;
-    Object*       object;
-    float         area;
+    const int                  maxPrimsInNode;
+    const SplitMethod          splitMethod;
+    const int                  nBuckets; // SAH 分桶数
+    const SimdLevel            simd;
+    std::vector<Object*>       primitives;
+    std::vector<LinearBVHNode> nodes;
+    // 由 nodes 合并得到的多叉 BVH，支持 AVX2 时使用 8 叉，否则使用 4 叉
+    std::unique_ptr<WideBVH<4>> wideBVH4;
+    std::unique_ptr<WideBVH<8>> wideBVH8;
+    // 图元全部为三角形时，叶子打包为 SoA 三角形块，求交不经过虚函数
+    bool packedTriangles = false;
+    int  leafWidth       = 1; // 一次可以同时求交的图元数
+    // 按 primitives 顺序累加的面积，用于按面积均匀采样
+    std::vector<float> areaCdf;
+    // 三角形网格的 BVH 不保存图元对象，命中的三角形都属于 owner，
+    // primitiveIds 按 BVH 顺序给出三角形的下标
+    Object*              owner = nullptr;
+    std::vector<int32_t> primitiveIds;
 
-  public:
-    int splitAxis = 0, firstPrimOffset = 0, nPrimitives = 0;
-    // BVHBuildNode Public Methods
-    BVHBuildNode() {
-        bounds = Bounds3();
-        left   = nullptr;
-        right  = nullptr;
-        object = nullptr;
-    }
+    void Sample(Intersection& pos, float& pdf) const;
 };
 
 #endif // RAYTRACING_BVH_H
@@ -0,0 +1,254 @@
+#include "BVHCache.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <random>
+#include <span>
+#include <system_error>
+
+namespace {
+    constexpr char     CACHE_MAGIC[8] = {'R', 'T', 'B', 'V', 'H', '\0', '\0', '\0'};
+    constexpr uint32_t CACHE_VERSION  = 3;
+    // 各段的起点按缓存行对齐，映射后可以直接作为 alignas(32) 的结构使用
+    constexpr uint64_t SECTION_ALIGN = 64;
+
+    enum Section {
+        POSITIONS,
+        TEXCOORDS,
+        INDICES,
+        ORDER,
+        NODES,
+        WIDE_NODES,
+        BLOCKS,
+        SECTION_COUNT
+    };
+
+    struct SectionInfo {
+        uint64_t offset;
+        uint64_t count;
+        uint32_t elementSize;
+        uint32_t pad;
+    };
+
+    struct CacheHeader {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    width; // 多叉 BVH 的宽度
+        uint64_t    key;
+        SectionInfo sections[SECTION_COUNT];
+    };
+
+    auto elementSizes(int width) -> std::array<uint32_t, SECTION_COUNT> {
+        bool wide8 = width == 8;
+        return {sizeof(MeshFile::Float3), sizeof(MeshFile::Float2), sizeof(uint32_t),
+                sizeof(int32_t), sizeof(LinearBVHNode),
+                uint32_t(wide8 ? sizeof(WideBVHNode<8>) : sizeof(WideBVHNode<4>)),
+                uint32_t(wide8 ? sizeof(TriangleBlock<8>) : sizeof(TriangleBlock<4>))};
+    }
+
+    // 每次处理 8 字节的乘法散列，只用于判断缓存是否过期
+    auto hashBytes(const uint8_t* data, size_t size, uint64_t h) -> uint64_t {
+        constexpr uint64_t MUL = 0x9E3779B97F4A7C15ULL;
+        size_t             i   = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, data + i, 8);
+            h  = (h ^ word) * MUL;
+            h ^= h >> 29;
+        }
+        for (; i < size; ++i) {
+            h  = (h ^ data[i]) * MUL;
+            h ^= h >> 29;
+        }
+        return h;
+    }
+
+    auto alignUp(uint64_t offset) -> uint64_t {
+        return (offset + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+    }
+
+    // 二叉 BVH 按深度优先顺序存放：右孩子在父节点之后，叶子的图元区间在 nPrims 之内
+    auto validNodes(std::span<const LinearBVHNode> nodes, size_t nPrims) -> bool {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const LinearBVHNode& node = nodes[i];
+            if (node.nPrimitives > 0) {
+                if (node.primitivesOffset < 0 ||
+                    size_t(node.primitivesOffset) + node.nPrimitives > nPrims) {
+                    return false;
+                }
+            } else if (node.axis > 2 || node.secondChildOffset <= int64_t(i) + 1 ||
+                       size_t(node.secondChildOffset) >= nodes.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 多叉 BVH 的孩子在父节点之后，深度不超过遍历栈能容纳的 64 层；叶子的块都在 blocks 之内，
+    // 块中的三角形编号小于 nPrims，空位为 -1 且三角形退化为点，不会被命中
+    template <int N>
+    auto validWideBVH(std::span<const WideBVHNode<N>>   nodes,
+                      std::span<const TriangleBlock<N>> blocks, size_t nPrims) -> bool {
+        constexpr int    MAX_DEPTH = 64;
+        std::vector<int> depth(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const WideBVHNode<N>& node = nodes[i];
+            if (node.count > N || depth[i] >= MAX_DEPTH) { return false; }
+            for (int c = 0; c < node.count; ++c) {
+                if (node.child[c] < 0) { return false; }
+                auto child = size_t(node.child[c]);
+                if (node.nPrims[c] > 0) {
+                    if (child + (node.nPrims[c] + N - 1) / N > blocks.size()) { return false; }
+                } else {
+                    if (child <= i || child >= nodes.size()) { return false; }
+                    depth[child] = std::max(depth[child], depth[i] + 1);
+                }
+            }
+        }
+        for (const TriangleBlock<N>& block : blocks) {
+            for (int j = 0; j < N; ++j) {
+                if (block.prim[j] >= 0) {
+                    if (size_t(block.prim[j]) >= nPrims) { return false; }
+                    continue;
+                }
+                if (block.prim[j] != -1) { return false; }
+                for (int a = 0; a < 3; ++a) {
+                    if (block.v0[a][j] != 0 || block.e1[a][j] != 0 || block.e2[a][j] != 0) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+} // namespace
+
+auto BVHCache::makeKey(const std::string& meshFile, int maxPrimsInNode,
+                       BVHAccel::SplitMethod splitMethod, int nBuckets, int width) -> uint64_t {
+    MappedFile file(meshFile);
+    if (!file.isOpen()) { return 0; }
+    const int32_t settings[5] = {int32_t(CACHE_VERSION), maxPrimsInNode, int32_t(splitMethod),
+                                 nBuckets, width};
+    uint64_t      seed        = hashBytes(reinterpret_cast<const uint8_t*>(settings),
+                                          sizeof(settings), file.size());
+    uint64_t      key         = hashBytes(file.data(), file.size(), seed);
+    return key != 0 ? key : 1;
+}
+
+auto BVHCache::save(const std::string& filename, uint64_t key, const BVHAccel& bvh,
+                    std::span<const MeshFile::Float3> positions,
+                    std::span<const MeshFile::Float2> texCoords, std::span<const uint32_t> indices)
+    -> bool {
+    // 没有图元时不会生成多叉 BVH
+    if (!bvh.wideBVH8 && !bvh.wideBVH4) { return false; }
+    int         width = bvh.wideBVH8 ? 8 : 4;
+    const void* wideNodes =
+        width == 8 ? (const void*)bvh.wideBVH8->nodes().data() : bvh.wideBVH4->nodes().data();
+    const void* blocks =
+        width == 8 ? (const void*)bvh.wideBVH8->blocks().data() : bvh.wideBVH4->blocks().data();
+    size_t nWideNodes = width == 8 ? bvh.wideBVH8->nodes().size() : bvh.wideBVH4->nodes().size();
+    size_t nBlocks    = width == 8 ? bvh.wideBVH8->blocks().size() : bvh.wideBVH4->blocks().size();
+
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.width   = uint32_t(width);
+    header.key     = key;
+    const auto& order                 = bvh.primitiveIds;
+    const void* data[SECTION_COUNT]   = {positions.data(), texCoords.data(), indices.data(),
+                                         order.data(),     bvh.nodes.data(),  wideNodes,
+                                         blocks};
+    uint64_t    counts[SECTION_COUNT] = {positions.size(), texCoords.size(), indices.size(),
+                                         order.size(),     bvh.nodes.size(),  nWideNodes,
+                                         nBlocks};
+    auto        sizes                 = elementSizes(width);
+    uint64_t    offset                = alignUp(sizeof(header));
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        header.sections[s] = {offset, counts[s], sizes[s], 0};
+        offset             = alignUp(offset + counts[s] * sizes[s]);
+    }
+
+    // 先写临时文件再改名，其它进程不会读到写了一半的缓存。多个工作进程可能同时未命中
+    // 并各自写缓存，临时文件名带随机后缀，互不覆盖
+    std::random_device random;
+    std::string        tmp = std::format("{}.{:08x}{:08x}.tmp", filename, random(), random());
+    FILE*       fp  = fopen(tmp.c_str(), "wb");
+    if (fp == nullptr) { return false; }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (int s = 0; s < SECTION_COUNT && ok; ++s) {
+        const SectionInfo& section = header.sections[s];
+        ok = fseek(fp, long(section.offset), SEEK_SET) == 0 &&
+             fwrite(data[s], section.elementSize, section.count, fp) == section.count;
+    }
+    // 末尾补齐，最后一段之后的对齐空间也属于文件。最后一段恰好对齐时不能再写，否则会覆盖它的
+    // 最后一个字节
+    const SectionInfo& last = header.sections[SECTION_COUNT - 1];
+    if (ok && offset > last.offset + last.count * last.elementSize) {
+        uint8_t zero = 0;
+        ok           = fseek(fp, long(offset - 1), SEEK_SET) == 0 && fwrite(&zero, 1, 1, fp) == 1;
+    }
+    ok = fclose(fp) == 0 && ok;
+
+    std::error_code error;
+    if (ok) { std::filesystem::rename(tmp, filename, error); }
+    if (!ok || error) {
+        std::filesystem::remove(tmp, error);
+        return false;
+    }
+    return true;
+}
+
+auto BVHCache::open(const std::string& filename, uint64_t key, int width) -> bool {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filename) || file->size() < sizeof(CacheHeader)) { return false; }
+    CacheHeader header{};
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CACHE_VERSION || header.key != key || int(header.width) != width) {
+        return false;
+    }
+    auto sizes = elementSizes(width);
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        const SectionInfo& section = header.sections[s];
+        if (section.elementSize != sizes[s] || section.offset % SECTION_ALIGN != 0 ||
+            section.offset > file->size() ||
+            section.count > (file->size() - section.offset) / section.elementSize) {
+            return false;
+        }
+    }
+    const SectionInfo* sections = header.sections;
+    if (sections[TEXCOORDS].count != sections[POSITIONS].count ||
+        sections[INDICES].count != sections[ORDER].count * 3) {
+        return false;
+    }
+
+    auto at    = [&](Section s) { return file->data() + sections[s].offset; };
+    positions_ = {reinterpret_cast<const MeshFile::Float3*>(at(POSITIONS)),
+                  sections[POSITIONS].count};
+    texCoords_ = {reinterpret_cast<const MeshFile::Float2*>(at(TEXCOORDS)),
+                  sections[TEXCOORDS].count};
+    indices_   = {reinterpret_cast<const uint32_t*>(at(INDICES)), sections[INDICES].count};
+    order_     = {reinterpret_cast<const int32_t*>(at(ORDER)), sections[ORDER].count};
+    nodes_     = {reinterpret_cast<const LinearBVHNode*>(at(NODES)), sections[NODES].count};
+    for (uint32_t index : indices_) {
+        if (index >= positions_.size()) { return false; }
+    }
+    for (int32_t index : order_) {
+        if (index < 0 || size_t(index) >= order_.size()) { return false; }
+    }
+    wideNodes_  = at(WIDE_NODES);
+    nWideNodes_ = sections[WIDE_NODES].count;
+    blocks_     = at(BLOCKS);
+    nBlocks_    = sections[BLOCKS].count;
+    // 遍历时不再检查下标，损坏的结构与其它不符一样视为未命中
+    bool valid = validNodes(nodes_, order_.size()) &&
+                 (width == 8 ? validWideBVH<8>(wideNodes<8>(), blocks<8>(), order_.size())
+                             : validWideBVH<4>(wideNodes<4>(), blocks<4>(), order_.size()));
+    if (!valid) { return false; }
+    width_ = width;
+    file_  = std::move(file);
+    return true;
+}
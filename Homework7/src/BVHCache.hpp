@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BVH.hpp"
+#include "MappedFile.hpp"
+#include "MeshFile.hpp"
+#include "WideBVH.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// 网格 BVH 的缓存文件
+//
+// 保存构建好的二叉 BVH、多叉 BVH 与打包的三角形块，以及网格去重后的顶点、三角形索引和
+// 图元顺序。打开时整个文件映射到内存，多叉 BVH 直接使用映射中的数据，不需要解析 OBJ，
+// 也不需要重新构建。文件头记录版本、各结构的大小与键，任一不符时视为未命中。
+class BVHCache {
+  public:
+    // 由网格文件的内容与构建设置得到的键，文件无法读取时返回 0
+    static auto makeKey(const std::string& meshFile, int maxPrimsInNode,
+                        BVHAccel::SplitMethod splitMethod, int nBuckets, int width) -> uint64_t;
+    // 写出缓存。indices 每三个构成一个三角形，图元顺序取自 bvh.primitiveIds
+    static auto save(const std::string& filename, uint64_t key, const BVHAccel& bvh,
+                     std::span<const MeshFile::Float3> positions,
+                     std::span<const MeshFile::Float2> texCoords,
+                     std::span<const uint32_t>         indices) -> bool;
+
+    // 映射缓存文件并校验，键或多叉 BVH 的宽度不符时返回 false
+    auto open(const std::string& filename, uint64_t key, int width) -> bool;
+
+    auto width() const -> int { return width_; }
+    auto positions() const -> std::span<const MeshFile::Float3> { return positions_; }
+    auto texCoords() const -> std::span<const MeshFile::Float2> { return texCoords_; }
+    auto indices() const -> std::span<const uint32_t> { return indices_; }
+    auto order() const -> std::span<const int32_t> { return order_; }
+    auto nodes() const -> std::span<const LinearBVHNode> { return nodes_; }
+    template <int N> auto wideNodes() const -> std::span<const WideBVHNode<N>> {
+        return {reinterpret_cast<const WideBVHNode<N>*>(wideNodes_), nWideNodes_};
+    }
+    template <int N> auto blocks() const -> std::span<const TriangleBlock<N>> {
+        return {reinterpret_cast<const TriangleBlock<N>*>(blocks_), nBlocks_};
+    }
+    // 映射的文件，在使用其中数据的对象析构之前需要保持打开
+    auto storage() const -> std::shared_ptr<const void> { return file_; }
+
+  private:
+    std::shared_ptr<MappedFile>       file_;
+    int                               width_ = 0;
+    std::span<const MeshFile::Float3> positions_;
+    std::span<const MeshFile::Float2> texCoords_;
+    std::span<const uint32_t>         indices_;
+    std::span<const int32_t>          order_;
+    std::span<const LinearBVHNode>    nodes_;
+    const void*                       wideNodes_  = nullptr;
+    size_t                            nWideNodes_ = 0;
+    const void*                       blocks_     = nullptr;
+    size_t                            nBlocks_    = 0;
+};
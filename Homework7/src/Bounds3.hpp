@@ -65,31 +65,32 @@ class Bounds3 {
     inline auto operator[](int i) const -> const Vector3f& { return (i == 0) ? pMin : pMax; }
 
     inline auto IntersectP(const Ray& ray, const Vector3f& invDir,
-                           const std::array<int, 3>& dirisNeg) const -> bool;
+                           const std::array<int, 3>& dirIsNeg, float tMax) const -> bool;
 };
 
 inline auto Bounds3::IntersectP(const Ray& ray, const Vector3f& invDir,
-                                const std::array<int, 3>& dirIsNeg) const -> bool {
+                                const std::array<int, 3>& dirIsNeg, float tMax) const -> bool {
     // invDir: ray direction(x,y,z), invDir=(1.0/x,1.0/y,1.0/z), use this because Multiply is faster
-    // that Division dirIsNeg: ray direction(x,y,z), dirIsNeg=[int(x>0),int(y>0),int(z>0)], use this
+    // that Division dirIsNeg: ray direction(x,y,z), dirIsNeg=[int(x<0),int(y<0),int(z<0)], use this
     // to simplify your logic
+    // tMax: 只接受进入距离不超过 tMax 的相交（例如已找到的最近交点）
     // DONE test if ray bound intersects
+    const Bounds3& bounds = *this;
 
-    double t_enter{-std::numeric_limits<double>::infinity()};
-    double t_exit{std::numeric_limits<double>::infinity()};
+    // 按方向符号直接选出进入面和离开面，无需交换
+    float t_enter{-std::numeric_limits<float>::infinity()};
+    float t_exit{std::numeric_limits<float>::infinity()};
 
-    Vector3f t_enter_v3f = (pMin - ray.origin) * invDir;
-    Vector3f t_exit_v3f  = (pMax - ray.origin) * invDir;
-
-    if (dirIsNeg[0] == 0) { std::swap(t_enter_v3f.x, t_exit_v3f.x); }
-    if (dirIsNeg[1] == 0) { std::swap(t_enter_v3f.y, t_exit_v3f.y); }
-    if (dirIsNeg[2] == 0) { std::swap(t_enter_v3f.z, t_exit_v3f.z); }
-
-    t_enter = std::max(t_enter_v3f.x, std::max(t_enter_v3f.y, t_enter_v3f.z));
-    t_exit  = std::min(t_exit_v3f.x, std::min(t_exit_v3f.y, t_exit_v3f.z));
+    // 光线起点位于平面上且方向分量为 0 时会得到 NaN，放在第二个参数让 std::max/min 忽略它
+    t_enter = std::max(t_enter, (bounds[dirIsNeg[0]].x - ray.origin.x) * invDir.x);
+    t_exit  = std::min(t_exit, (bounds[1 - dirIsNeg[0]].x - ray.origin.x) * invDir.x);
+    t_enter = std::max(t_enter, (bounds[dirIsNeg[1]].y - ray.origin.y) * invDir.y);
+    t_exit  = std::min(t_exit, (bounds[1 - dirIsNeg[1]].y - ray.origin.y) * invDir.y);
+    t_enter = std::max(t_enter, (bounds[dirIsNeg[2]].z - ray.origin.z) * invDir.z);
+    t_exit  = std::min(t_exit, (bounds[1 - dirIsNeg[2]].z - ray.origin.z) * invDir.z);
 
     // 包围盒可能是平面，此时离开的时间和进入的时间会相同
-    return t_enter <= t_exit && t_exit >= 0;
+    return t_enter <= t_exit && t_exit >= 0 && t_enter <= tMax;
 }
 
 inline auto Union(const Bounds3& b1, const Bounds3& b2) -> Bounds3 {
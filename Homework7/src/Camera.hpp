@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Ray.hpp"
+#include "Scene.hpp"
+#include "Vector.hpp"
+
+inline auto deg2rad(const float& deg) -> float { return deg * M_PI / 180.0; }
+
+// 针孔相机，光线穿过像素中心
+class Camera {
+  public:
+    explicit Camera(const Scene& scene)
+        : eye_pos(scene.eye), width(scene.width), height(scene.height),
+          scale(tan(deg2rad(scene.fov * 0.5))),
+          imageAspectRatio(scene.width / (float)scene.height) {}
+
+    // generate primary ray direction
+    auto generateRay(int i, int j) const -> Ray {
+        float x = (2 * (i + 0.5) / (float)width - 1) * imageAspectRatio * scale;
+        float y = (1 - 2 * (j + 0.5) / (float)height) * scale;
+        return {eye_pos, normalize(Vector3f(-x, y, 1))};
+    }
+
+    Vector3f eye_pos;
+    int      width, height;
+    float    scale;
+    float    imageAspectRatio;
+};
@@ -0,0 +1,94 @@
+#include "Checkpoint.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+namespace {
+    constexpr char     CHECKPOINT_MAGIC[8] = {'R', 'T', 'C', 'K', 'P', 'T', '\0', '\0'};
+    constexpr uint32_t CHECKPOINT_VERSION  = 1;
+
+    struct CheckpointHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t pixelSize; // sizeof(PixelStats)，布局变化后旧文件不再可用
+        int32_t  width;
+        int32_t  height;
+    };
+} // namespace
+
+auto saveCheckpoint(const std::string& filename, int width, int height,
+                    const std::vector<PixelStats>& stats) -> bool {
+    CheckpointHeader header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version   = CHECKPOINT_VERSION;
+    header.pixelSize = sizeof(PixelStats);
+    header.width     = width;
+    header.height    = height;
+
+    std::string tmp = filename + ".tmp";
+    FILE*       fp  = fopen(tmp.c_str(), "wb");
+    if (fp == nullptr) { return false; }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(stats.data(), sizeof(PixelStats), stats.size(), fp) == stats.size();
+    ok = fclose(fp) == 0 && ok;
+
+    std::error_code error;
+    if (ok) { std::filesystem::rename(tmp, filename, error); }
+    if (!ok || error) {
+        std::filesystem::remove(tmp, error);
+        return false;
+    }
+    return true;
+}
+
+auto loadCheckpoint(const std::string& filename, int width, int height,
+                    std::vector<PixelStats>& stats) -> bool {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr) { return false; }
+    CheckpointHeader        header{};
+    std::vector<PixelStats> loaded(size_t(width) * height);
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CHECKPOINT_VERSION && header.pixelSize == sizeof(PixelStats) &&
+              header.width == width && header.height == height &&
+              fread(loaded.data(), sizeof(PixelStats), loaded.size(), fp) == loaded.size();
+    fclose(fp);
+    if (ok) { stats.swap(loaded); }
+    return ok;
+}
+
+Checkpointer::Checkpointer(std::string filename, int width, int height,
+                           const std::vector<PixelStats>& stats, float interval)
+    : filename_(std::move(filename)), width_(width), height_(height), stats_(stats),
+      interval_(interval), thread_([this] { run(); }) {}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        stop_ = true;
+    }
+    stopSignal_.notify_one();
+    thread_.join();
+    write();
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    while (!stopSignal_.wait_for(lock, interval_, [this] { return stop_; })) {
+        lock.unlock();
+        write();
+        lock.lock();
+    }
+}
+
+void Checkpointer::write() {
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        snapshot_ = stats_;
+    }
+    if (!saveCheckpoint(filename_, width_, height_, snapshot_)) {
+        std::cerr << "\nFailed to write checkpoint " << filename_ << "\n";
+    }
+}
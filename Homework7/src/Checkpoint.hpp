@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Renderer.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 渐进渲染的断点文件
+//
+// 文件头之后是全部像素的 PixelStats（均值、方差累加量与样本数），按小端序原样存放。
+// 每个样本的随机数只由像素与样本序号决定，从断点继续渲染的结果与不中断时逐位相同。
+// 写入时先写临时文件再改名，写到一半被打断也不会损坏已有的断点。
+auto saveCheckpoint(const std::string& filename, int width, int height,
+                    const std::vector<PixelStats>& stats) -> bool;
+// 尺寸与文件不一致或文件损坏时返回 false，stats 保持不变
+auto loadCheckpoint(const std::string& filename, int width, int height,
+                    std::vector<PixelStats>& stats) -> bool;
+
+// 在后台线程中定期写断点
+//
+// 渲染线程写回 stats 时需要持有 mutex()，后台线程只在复制快照时持有它，
+// 文件写入在锁外进行，渲染线程不会因为磁盘 I/O 而停顿。
+class Checkpointer {
+  public:
+    Checkpointer(std::string filename, int width, int height, const std::vector<PixelStats>& stats,
+                 float interval);
+    Checkpointer(const Checkpointer&)                    = delete;
+    auto operator=(const Checkpointer&) -> Checkpointer& = delete;
+    // 停止后台线程并写出最后一份断点
+    ~Checkpointer();
+
+    auto mutex() -> std::mutex& { return statsMutex_; }
+
+  private:
+    void run();
+    void write();
+
+    std::string                    filename_;
+    int                            width_;
+    int                            height_;
+    const std::vector<PixelStats>& stats_;
+    std::chrono::duration<float>   interval_;
+
+    std::mutex              statsMutex_; // 保护 stats_
+    std::mutex              stopMutex_;
+    std::condition_variable stopSignal_;
+    bool                    stop_ = false;
+    std::vector<PixelStats> snapshot_;
+    std::thread             thread_;
+};
@@ -0,0 +1,82 @@
+#include "CornellBox.hpp"
+#include "BVHCache.hpp"
+#include "MeshFile.hpp"
+#include "MeshInstance.hpp"
+#include "Triangle.hpp"
+#include <algorithm>
+#include <cmath>
+
+CornellBox::CornellBox(const SceneOptions& options) : scene(options.width, options.height) {
+    configure(options);
+
+    Material* red   = material(DIFFUSE);
+    red->Kd         = Vector3f(0.63F, 0.065F, 0.05F);
+    Material* green = material(DIFFUSE);
+    green->Kd       = Vector3f(0.14F, 0.45F, 0.091F);
+    Material* white = material(DIFFUSE);
+    white->Kd       = Vector3f(0.725F, 0.71F, 0.68F);
+    Material* light =
+        material(DIFFUSE, (8.0F * Vector3f(0.747F + 0.058F, 0.747F + 0.258F, 0.747F) +
+                           15.6F * Vector3f(0.740F + 0.287F, 0.740F + 0.160F, 0.740F) +
+                           18.4F * Vector3f(0.737F + 0.642F, 0.737F + 0.159F, 0.737F)));
+    light->Kd = Vector3f(0.65F);
+
+    Material* metal  = material(MICROFACET);
+    metal->Kd        = Vector3f(0.05F);
+    metal->Ks        = Vector3f(0.95F, 0.64F, 0.54F);
+    metal->roughness = options.glossy;
+
+    auto add = [&](const char* name, Material* m) {
+        meshes_.push_back(std::make_unique<MeshTriangle>(
+            preferMeshFile(std::string("./res/models/cornellbox/") + name), m, options.simd,
+            options.bvhBuild, options.bvhCache));
+        scene.Add(meshes_.back().get());
+    };
+    add("floor.obj", white);
+    add("shortbox.obj", white);
+    add("tallbox.obj", options.glossy >= 0 ? metal : white);
+    add("left.obj", red);
+    add("right.obj", green);
+    add("light.obj", light);
+
+    // 兔子网格只加载一次，所有实例共享同一份三角形与底层 BVH
+    if (options.instances > 0) {
+        meshes_.push_back(std::make_unique<MeshTriangle>(
+            preferMeshFile("./res/models/bunny/bunny.obj"), white, options.simd, options.bvhBuild,
+            options.bvhCache));
+        MeshTriangle* bunny  = meshes_.back().get();
+        Bounds3       b      = bunny->getBounds();
+        Vector3f      center = 0.5F * (b.pMin + b.pMax);
+        int           n      = options.instances;
+        int           k      = int(std::ceil(std::sqrt(float(n))));
+        float         cell   = 556.F / float(k);
+        float         scale  = 0.8F * cell / std::max(b.Diagonal().x, b.Diagonal().z);
+        for (int i = 0; i < n; ++i) {
+            // 网格排列在地面上，每只绕 y 轴转过黄金角
+            Vector3f  pos((float(i % k) + 0.5F) * cell, 0, (float(i / k) + 0.5F) * cell);
+            Transform toOrigin = Transform::Translate(Vector3f(-center.x, -b.pMin.y, -center.z));
+            Transform place    = Transform::Translate(pos) *
+                              Transform::Rotate(137.5F * float(i), Vector3f(0, 1, 0)) *
+                              Transform::Scale(scale, scale, scale) * toOrigin;
+            instances_.push_back(std::make_unique<MeshInstance>(bunny, place));
+            scene.Add(instances_.back().get());
+        }
+    }
+
+    scene.buildBVH(options.bvhBuild, options.simd);
+}
+
+CornellBox::~CornellBox() = default;
+
+void CornellBox::configure(const SceneOptions& options) {
+    scene.width  = options.width;
+    scene.height = options.height;
+    scene.fov    = options.fov;
+    scene.eye    = options.eye;
+    scene.mis    = options.mis;
+}
+
+auto CornellBox::material(MaterialType type, const Vector3f& emission) -> Material* {
+    materials_.push_back(std::make_unique<Material>(type, emission));
+    return materials_.back().get();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BVH.hpp"
+#include "Material.hpp"
+#include "Scene.hpp"
+#include "WideBVH.hpp"
+#include <memory>
+#include <tuple>
+#include <vector>
+
+// Triangle.hpp 中有非内联的定义，只能由一个翻译单元包含
+class MeshInstance;
+class MeshTriangle;
+
+// 场景设置
+struct SceneOptions {
+    int   instances = 0;  // 地面上摆放的兔子实例数
+    float glossy    = -1; // 大于等于 0 时高盒子改用 GGX 材质，取值为粗糙度
+    bool  mis       = true;
+
+    // 相机与分辨率，修改它们不需要重新构建 BVH
+    int      width  = 784;
+    int      height = 784;
+    float    fov    = 40;
+    Vector3f eye    = Vector3f(278, 273, -800);
+
+    // BVH 的构建设置，构建场景时传给各网格与场景的 BVH
+    SimdLevel             simd     = detectSimdLevel();
+    BVHAccel::SplitMethod bvhBuild = BVHAccel::SplitMethod::SAH;
+    bool                  bvhCache = true;
+
+    // 决定几何、材质与 BVH 的设置，相同时可以共用同一份网格与 BVH
+    using GeometryKey = std::tuple<int, float, SimdLevel, BVHAccel::SplitMethod, bool>;
+    auto geometryKey() const -> GeometryKey {
+        return {instances, glossy, simd, bvhBuild, bvhCache};
+    }
+};
+
+// Cornell box 场景，持有其中的全部材质、网格与 BVH
+class CornellBox {
+  public:
+    // 加载网格并构建 BVH
+    explicit CornellBox(const SceneOptions& options);
+    CornellBox(const CornellBox&)                    = delete;
+    auto operator=(const CornellBox&) -> CornellBox& = delete;
+    ~CornellBox();
+
+    // 应用不影响几何的设置
+    void configure(const SceneOptions& options);
+
+    Scene scene;
+
+  private:
+    auto material(MaterialType type, const Vector3f& emission = Vector3f(0.0F)) -> Material*;
+
+    std::vector<std::unique_ptr<Material>>     materials_;
+    std::vector<std::unique_ptr<MeshTriangle>> meshes_;
+    std::vector<std::unique_ptr<MeshInstance>> instances_;
+};
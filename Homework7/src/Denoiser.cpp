@@ -0,0 +1,130 @@
+#include "Denoiser.hpp"
+#include "omp.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    auto luminance(const Vector3f& c) -> float {
+        return 0.2126F * c.x + 0.7152F * c.y + 0.0722F * c.z;
+    }
+
+    // 反照率过小时光照无法可靠地分离出来，以此为下限
+    constexpr float MIN_ALBEDO = 1e-3F;
+
+    // 一维 B 样条核 (1, 4, 6, 4, 1) / 16
+    constexpr float KERNEL[5] = {1.F / 16, 1.F / 4, 3.F / 8, 1.F / 4, 1.F / 16};
+} // namespace
+
+void Denoiser::denoise(std::vector<Vector3f>& color, std::vector<float> variance,
+                       const GBuffer& features) const {
+    int nPixels = width_ * height_;
+
+    // 除以反照率得到光照，方差按反照率亮度的平方缩放
+    std::vector<Vector3f> irradiance(nPixels);
+    for (int i = 0; i < nPixels; ++i) {
+        Vector3f a     = Vector3f::Max(features.albedo[i], Vector3f(MIN_ALBEDO));
+        irradiance[i]  = Vector3f(color[i].x / a.x, color[i].y / a.y, color[i].z / a.z);
+        float la       = std::max(luminance(features.albedo[i]), MIN_ALBEDO);
+        variance[i]   /= la * la;
+    }
+
+    // 深度梯度：每个方向取前后差分中较小的一个，避免在物体边缘处被放大
+    std::vector<float> gradX(nPixels, 0.F);
+    std::vector<float> gradY(nPixels, 0.F);
+    const auto&        depth = features.depth;
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            int   p  = y * width_ + x;
+            float gx = std::numeric_limits<float>::infinity();
+            float gy = std::numeric_limits<float>::infinity();
+            if (x > 0) { gx = std::min(gx, std::fabs(depth[p] - depth[p - 1])); }
+            if (x + 1 < width_) { gx = std::min(gx, std::fabs(depth[p] - depth[p + 1])); }
+            if (y > 0) { gy = std::min(gy, std::fabs(depth[p] - depth[p - width_])); }
+            if (y + 1 < height_) { gy = std::min(gy, std::fabs(depth[p] - depth[p + width_])); }
+            // 未命中的像素深度为无穷大，差分没有意义
+            gradX[p] = std::isfinite(gx) ? gx : 0.F;
+            gradY[p] = std::isfinite(gy) ? gy : 0.F;
+        }
+    }
+
+    std::vector<Vector3f> tmpColor(nPixels);
+    std::vector<float>    tmpVariance(nPixels);
+    for (int i = 0; i < options_.iterations; ++i) {
+        filterPass(1 << i, irradiance, variance, features, gradX, gradY, tmpColor, tmpVariance);
+        irradiance.swap(tmpColor);
+        variance.swap(tmpVariance);
+    }
+
+    // 乘回反照率
+    for (int i = 0; i < nPixels; ++i) {
+        color[i] = irradiance[i] * Vector3f::Max(features.albedo[i], Vector3f(MIN_ALBEDO));
+    }
+}
+
+void Denoiser::filterPass(int step, const std::vector<Vector3f>& color,
+                          const std::vector<float>& variance, const GBuffer& features,
+                          const std::vector<float>& gradX, const std::vector<float>& gradY,
+                          std::vector<Vector3f>& outColor, std::vector<float>& outVariance) const {
+#pragma omp parallel for num_threads(nThreads_) schedule(dynamic, 4)
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            int p = y * width_ + x;
+            // 背景没有可用的特征，保持原样
+            if (!std::isfinite(features.depth[p])) {
+                outColor[p]    = color[p];
+                outVariance[p] = variance[p];
+                continue;
+            }
+
+            // 亮度权重使用 3x3 高斯模糊后的方差，降低方差估计本身的噪声
+            float var  = 0;
+            float wVar = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int qx = x + dx;
+                    int qy = y + dy;
+                    if (qx < 0 || qx >= width_ || qy < 0 || qy >= height_) { continue; }
+                    float w  = KERNEL[dx * 2 + 2] * KERNEL[dy * 2 + 2];
+                    var     += w * variance[qy * width_ + qx];
+                    wVar    += w;
+                }
+            }
+            float sigmaL = options_.sigmaColor * std::sqrt(var / wVar) + 1e-6F;
+
+            const Vector3f& nP = features.normal[p];
+            float           zP = features.depth[p];
+            float           lP = luminance(color[p]);
+
+            Vector3f sumColor(0.F);
+            float    sumVariance = 0;
+            float    sumWeight   = 0;
+            for (int oy = -2; oy <= 2; ++oy) {
+                for (int ox = -2; ox <= 2; ++ox) {
+                    int qx = x + ox * step;
+                    int qy = y + oy * step;
+                    if (qx < 0 || qx >= width_ || qy < 0 || qy >= height_) { continue; }
+                    int   q  = qy * width_ + qx;
+                    float zQ = features.depth[q];
+                    if (!std::isfinite(zQ)) { continue; }
+
+                    float wN = std::pow(std::max(0.F, dotProduct(nP, features.normal[q])),
+                                        options_.sigmaNormal);
+                    float grad = gradX[p] * float(std::abs(ox)) + gradY[p] * float(std::abs(oy));
+                    float wZ   = std::exp(-std::fabs(zP - zQ) /
+                                          (options_.sigmaDepth * float(step) * grad + 1e-2F));
+                    float wL = std::exp(-std::fabs(lP - luminance(color[q])) / sigmaL);
+                    float w  = KERNEL[ox + 2] * KERNEL[oy + 2] * wN * wZ * wL;
+                    if (!(w > 0)) { continue; }
+
+                    sumColor    += w * color[q];
+                    sumVariance += w * w * variance[q];
+                    sumWeight   += w;
+                }
+            }
+            // 中心像素的权重恒为正
+            outColor[p]    = sumColor / sumWeight;
+            outVariance[p] = sumVariance / (sumWeight * sumWeight);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GBuffer.hpp"
+#include "Vector.hpp"
+#include <vector>
+
+struct DenoiseOptions {
+    int   iterations  = 5;     // à-trous 迭代次数，第 i 次的采样间隔为 2^i 个像素
+    float sigmaColor  = 4.F;   // 亮度差按局部标准差的倍数衰减
+    float sigmaNormal = 128.F; // 法线夹角余弦的指数
+    float sigmaDepth  = 1.F;   // 深度差按深度梯度的倍数衰减
+};
+
+// 特征引导的边缘保持 à-trous 小波滤波（SVGF 的空间滤波部分）
+//
+// 颜色先除以反照率得到光照，只对光照滤波，纹理与材质边界不会被抹平。
+// 每次迭代用 5x5 的 B 样条核，采样间隔逐次翻倍；邻域像素的权重由法线、深度
+// 以及按方差归一化的亮度差共同决定，方差随滤波一起传播。
+class Denoiser {
+  public:
+    Denoiser(int width, int height, int nThreads, const DenoiseOptions& options = {})
+        : width_(width), height_(height), nThreads_(nThreads), options_(options) {}
+
+    // color 原位滤波，variance 为每个像素均值的亮度方差，样本不足时可以为无穷大
+    void denoise(std::vector<Vector3f>& color, std::vector<float> variance,
+                 const GBuffer& features) const;
+
+  private:
+    // 一次 à-trous 迭代，从 (color, variance) 滤波到 (outColor, outVariance)
+    void filterPass(int step, const std::vector<Vector3f>& color,
+                    const std::vector<float>& variance, const GBuffer& features,
+                    const std::vector<float>& gradX, const std::vector<float>& gradY,
+                    std::vector<Vector3f>& outColor, std::vector<float>& outVariance) const;
+
+    int            width_;
+    int            height_;
+    int            nThreads_;
+    DenoiseOptions options_;
+};
@@ -0,0 +1,167 @@
+#include "Distributed.hpp"
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define fdopen _fdopen
+#define fileno _fileno
+#define popen _popen
+#define pclose _pclose
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char     WORKER_MAGIC[8] = {'R', 'T', 'W', 'O', 'R', 'K', '\0', '\0'};
+    constexpr uint32_t WORKER_VERSION  = 1;
+#ifdef _WIN32
+    constexpr const char* PIPE_MODE   = "rb";
+    constexpr const char* NULL_DEVICE = "NUL";
+#else
+    constexpr const char* PIPE_MODE   = "r"; // glibc 不接受 "rb"
+    constexpr const char* NULL_DEVICE = "/dev/null";
+#endif
+
+    struct WorkerHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t pixelSize; // sizeof(PixelStats)
+        int32_t  width;
+        int32_t  height;
+        int32_t  tileCount;
+        int32_t  workerIndex;
+        int32_t  workerCount;
+    };
+
+    auto makeHeader(const TileScheduler& tiles, int workerIndex, int workerCount)
+        -> WorkerHeader {
+        WorkerHeader header{};
+        std::memcpy(header.magic, WORKER_MAGIC, sizeof(header.magic));
+        header.version     = WORKER_VERSION;
+        header.pixelSize   = sizeof(PixelStats);
+        header.width       = tiles.width();
+        header.height      = tiles.height();
+        header.tileCount   = tiles.tileCount();
+        header.workerIndex = workerIndex;
+        header.workerCount = workerCount;
+        return header;
+    }
+
+    // 读取一个工作进程的全部结果，块的划分与协调进程不一致时返回 false
+    auto readWorkerResult(FILE* in, const TileScheduler& tiles, int workerIndex, int workerCount,
+                          std::vector<PixelStats>& stats) -> bool {
+        WorkerHeader expected = makeHeader(tiles, workerIndex, workerCount);
+        WorkerHeader header{};
+        if (fread(&header, sizeof(header), 1, in) != 1 ||
+            std::memcmp(&header, &expected, sizeof(header)) != 0) {
+            return false;
+        }
+        // 各进程的块互不重叠，直接读到最终位置
+        for (int t = 0; t < tiles.tileCount(); ++t) {
+            if (!ownsTile(t, workerIndex, workerCount)) { continue; }
+            Tile tile = tiles.tile(t);
+            for (int y = tile.y0; y < tile.y1; ++y) {
+                auto n = size_t(tile.width());
+                if (fread(&stats[size_t(y) * tiles.width() + tile.x0], sizeof(PixelStats), n,
+                          in) != n) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+} // namespace
+
+auto workerResultStream() -> FILE* {
+    static FILE* stream = [] {
+        fflush(stdout);
+        int   fd     = dup(fileno(stdout));
+        FILE* result = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+        if (freopen(NULL_DEVICE, "w", stdout) == nullptr) {
+            std::cerr << "Cannot redirect standard output to " << NULL_DEVICE << "\n";
+        }
+        return result;
+    }();
+    return stream;
+}
+
+auto writeWorkerResult(FILE* out, const TileScheduler& tiles, int workerIndex, int workerCount,
+                       const std::vector<PixelStats>& stats) -> bool {
+    if (out == nullptr) { return false; }
+    WorkerHeader header = makeHeader(tiles, workerIndex, workerCount);
+    if (fwrite(&header, sizeof(header), 1, out) != 1) { return false; }
+    for (int t = 0; t < tiles.tileCount(); ++t) {
+        if (!ownsTile(t, workerIndex, workerCount)) { continue; }
+        Tile tile = tiles.tile(t);
+        for (int y = tile.y0; y < tile.y1; ++y) {
+            auto n = size_t(tile.width());
+            if (fwrite(&stats[size_t(y) * tiles.width() + tile.x0], sizeof(PixelStats), n, out) !=
+                n) {
+                return false;
+            }
+        }
+    }
+    return fflush(out) == 0;
+}
+
+auto quoteArgument(std::string_view arg, std::string& quoted) -> bool {
+#ifdef _WIN32
+    if (arg.find_first_of("\"%\r\n") != std::string_view::npos) { return false; }
+    // 结尾的反斜杠会转义右引号，需要加倍
+    size_t backslashes = 0;
+    while (backslashes < arg.size() && arg[arg.size() - 1 - backslashes] == '\\') {
+        ++backslashes;
+    }
+    quoted = "\"" + std::string(arg) + std::string(backslashes, '\\') + "\"";
+#else
+    // 单引号内没有任何特殊字符，单引号本身写成 '\''
+    quoted = "'";
+    for (char c : arg) { quoted += c == '\'' ? std::string("'\\''") : std::string(1, c); }
+    quoted += "'";
+#endif
+    return true;
+}
+
+auto runWorkers(const std::vector<std::string>& args, int workerCount,
+                const TileScheduler& tiles, std::vector<PixelStats>& stats) -> bool {
+    std::string command;
+    for (const std::string& arg : args) {
+        std::string quoted;
+        if (!quoteArgument(arg, quoted)) {
+            std::cerr << "Cannot pass argument to workers: " << arg << "\n";
+            return false;
+        }
+        command += (command.empty() ? "" : " ") + quoted;
+    }
+
+    // 先启动全部工作进程，它们并行渲染；结果写满管道后会阻塞，直到轮到它被读取
+    std::vector<FILE*> pipes(workerCount, nullptr);
+    bool               ok = true;
+    for (int k = 0; k < workerCount && ok; ++k) {
+        std::string line = command + " --worker " + std::to_string(k) + "/" +
+                           std::to_string(workerCount);
+#ifdef _WIN32
+        // cmd /c 会去掉首尾的引号，整行再套一层
+        line = "\"" + line + "\"";
+#endif
+        pipes[k] = popen(line.c_str(), PIPE_MODE);
+        if (pipes[k] == nullptr) {
+            std::cerr << "Cannot start worker " << k << ": " << line << "\n";
+            ok = false;
+        }
+    }
+
+    for (int k = 0; k < workerCount; ++k) {
+        if (pipes[k] == nullptr) { continue; }
+        bool received = ok && readWorkerResult(pipes[k], tiles, k, workerCount, stats);
+        // pclose 等待进程退出，返回非 0 表示它异常结束
+        bool exited = pclose(pipes[k]) == 0;
+        if (ok && !(received && exited)) {
+            std::cerr << "Worker " << k << " failed\n";
+            ok = false;
+        }
+        if (ok) { std::cout << "Worker " << k + 1 << "/" << workerCount << " finished\n"; }
+    }
+    return ok;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Renderer.hpp"
+#include "TileScheduler.hpp"
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 多进程渲染
+//
+// 协调进程以 --worker k/n 启动 n 个工作进程，每个工作进程自行构建场景与 BVH，
+// 只渲染按块下标交错分给它的块，结束后把这些块的 PixelStats 从标准输出写回。
+// 各进程负责的块互不重叠，样本的随机数只由像素与样本序号决定，
+// 合并后的结果与单进程渲染逐位相同。
+
+// 块按下标交错分配，相邻的块落在不同进程上，各进程的工作量大致相同
+inline auto ownsTile(int tileIndex, int workerIndex, int workerCount) -> bool {
+    return tileIndex % workerCount == workerIndex;
+}
+
+// 工作进程的结果通道。第一次调用时复制一份标准输出作为结果通道，再把标准输出
+// 指向空设备，场景构建与渲染过程中打印的日志不会混进结果。工作进程应在打印任何
+// 内容之前调用它
+auto workerResultStream() -> FILE*;
+
+// 工作进程：依次写出自己负责的各块的统计结果，块内按行优先顺序
+auto writeWorkerResult(FILE* out, const TileScheduler& tiles, int workerIndex, int workerCount,
+                       const std::vector<PixelStats>& stats) -> bool;
+
+// 给 arg 加上引号，经 popen 使用的 shell 解析后仍是原样的一个参数。
+// cmd.exe 在引号内也会处理 " 与 %，Windows 上含这些字符的参数无法安全传递，返回 false
+auto quoteArgument(std::string_view arg, std::string& quoted) -> bool;
+
+// 协调进程：以 args --worker k/n 启动 workerCount 个工作进程，args[0] 为程序路径，
+// 把结果合并到 stats。任一工作进程失败时返回 false
+auto runWorkers(const std::vector<std::string>& args, int workerCount,
+                const TileScheduler& tiles, std::vector<PixelStats>& stats) -> bool;
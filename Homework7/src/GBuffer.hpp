@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Vector.hpp"
+#include <cstdint>
+#include <vector>
+
+// 任意输出变量 (AOV)，与颜色在同一次渲染中得到
+enum class AOV { NORMAL, ALBEDO, DEPTH, OBJECT_ID, SAMPLES, COUNT };
+
+// 命令行与输出文件名中使用的名称，与 AOV 的顺序一致
+inline constexpr const char* AOV_NAMES[] = {"normal", "albedo", "depth", "id", "samples"};
+
+// 相机光线首个交点处的信息。每个像素的相机光线固定，求交一次即可得到
+struct GBuffer {
+    std::vector<Vector3f> albedo;   // 材质反照率，未命中时为 1
+    std::vector<Vector3f> normal;   // 单位法线，未命中时为 0
+    std::vector<float>    depth;    // 交点距离，未命中时为无穷大
+    std::vector<int32_t>  objectId; // 场景中顶层物体的下标，未命中时为 -1
+};
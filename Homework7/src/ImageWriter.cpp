@@ -0,0 +1,297 @@
+#include "ImageWriter.hpp"
+#include "global.hpp"
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // 逐像素量化的原始定义，查找表由它生成
+    auto encodeExact(Transfer transfer, float x) -> int {
+        switch (transfer) {
+            case Transfer::GAMMA: {
+                return (unsigned char)(255 * std::pow(clamp(0, 1, x), 0.6F));
+            }
+            case Transfer::SRGB: {
+                float v = clamp(0, 1, x);
+                v = v <= 0.0031308F ? 12.92F * v : 1.055F * std::pow(v, 1 / 2.4F) - 0.055F;
+                return (unsigned char)(255 * v + 0.5F);
+            }
+            case Transfer::LINEAR: {
+                return (unsigned char)(255 * clamp(0, 1, x));
+            }
+        }
+        return 0;
+    }
+
+    auto bitsToFloat(uint32_t bits) -> float {
+        float x = 0;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    // 舍入到最近偶数，溢出为无穷大
+    auto floatToHalf(float f) -> uint16_t {
+        uint32_t x = 0;
+        std::memcpy(&x, &f, sizeof(x));
+        uint32_t sign = (x >> 16) & 0x8000U;
+        uint32_t absx = x & 0x7FFFFFFFU;
+        if (absx >= 0x7F800000U) { // 无穷大与 NaN
+            return uint16_t(sign | 0x7C00U | (absx > 0x7F800000U ? 0x200U : 0U));
+        }
+        if (absx >= 0x477FF000U) { return uint16_t(sign | 0x7C00U); } // 不小于 65520
+        if (absx < 0x38800000U) {
+            // 非规格化数，单位为 2^-24
+            if (absx < 0x33000000U) { return uint16_t(sign); }
+            uint32_t shift = 126 - (absx >> 23);
+            uint32_t m     = (absx & 0x7FFFFFU) | 0x800000U;
+            uint32_t r     = m >> shift;
+            uint32_t rem   = m & ((1U << shift) - 1);
+            uint32_t half  = 1U << (shift - 1);
+            if (rem > half || (rem == half && (r & 1U) != 0)) { ++r; }
+            return uint16_t(sign | r);
+        }
+        // 指数偏移从 127 改为 15，尾数保留 10 位，进位会自然进到指数
+        uint32_t r   = (absx - 0x38000000U) >> 13;
+        uint32_t rem = absx & 0x1FFFU;
+        if (rem > 0x1000U || (rem == 0x1000U && (r & 1U) != 0)) { ++r; }
+        return uint16_t(sign | r);
+    }
+
+    // P6，8 位
+    class PPMWriter : public ImageWriter {
+      public:
+        explicit PPMWriter(Transfer transfer) : encoder_(transfer) {}
+
+      protected:
+        auto writeHeader() -> int64_t override {
+            (void)fprintf(fp_, "P6\n%d %d\n255\n", width_, height_);
+            return int64_t(width_) * height_ * 3;
+        }
+
+        void writeRow(int x0, int y, int n, const Vector3f* pixels) override {
+            buffer_.resize(size_t(n) * 3);
+            for (int i = 0; i < n; ++i) {
+                buffer_[i * 3]     = encoder_(pixels[i].x);
+                buffer_[i * 3 + 1] = encoder_(pixels[i].y);
+                buffer_[i * 3 + 2] = encoder_(pixels[i].z);
+            }
+            writeAt(dataOffset_ + (int64_t(y) * width_ + x0) * 3, buffer_.data(), buffer_.size());
+        }
+
+      private:
+        ByteEncoder encoder_;
+    };
+
+    // Portable Float Map，RGB 32 位浮点，比例因子为负表示小端序，各行自下而上存放
+    class PFMWriter : public ImageWriter {
+      protected:
+        auto writeHeader() -> int64_t override {
+            (void)fprintf(fp_, "PF\n%d %d\n-1.0\n", width_, height_);
+            return int64_t(width_) * height_ * 12;
+        }
+
+        void writeRow(int x0, int y, int n, const Vector3f* pixels) override {
+            buffer_.resize(size_t(n) * 12);
+            for (int i = 0; i < n; ++i) {
+                float rgb[3] = {pixels[i].x, pixels[i].y, pixels[i].z};
+                std::memcpy(&buffer_[i * 12], rgb, 12);
+            }
+            int64_t row = height_ - 1 - y;
+            writeAt(dataOffset_ + (row * width_ + x0) * 12, buffer_.data(), buffer_.size());
+        }
+    };
+
+    // OpenEXR 单部分扫描线文件，不压缩，每块一行
+    //
+    // 未压缩时每行的大小固定，偏移表可以在打开时写出，各块直接写到对应位置。
+    // 块内按通道名的字母顺序 (B, G, R) 依次存放整行数据。
+    class EXRWriter : public ImageWriter {
+      public:
+        explicit EXRWriter(bool half) : half_(half) {}
+
+      protected:
+        auto writeHeader() -> int64_t override {
+            std::vector<uint8_t> header;
+            auto                 put = [&](const void* data, size_t size) {
+                auto* p = static_cast<const uint8_t*>(data);
+                header.insert(header.end(), p, p + size);
+            };
+            auto putInt = [&](int32_t v) { put(&v, 4); };
+            auto putStr = [&](std::string_view s) {
+                put(s.data(), s.size());
+                header.push_back(0);
+            };
+            auto attribute = [&](std::string_view name, std::string_view type, int32_t size) {
+                putStr(name);
+                putStr(type);
+                putInt(size);
+            };
+
+            const uint8_t magic[8] = {0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0};
+            put(magic, sizeof(magic));
+
+            int32_t pixelType = half_ ? 1 : 2; // HALF : FLOAT
+            attribute("channels", "chlist", 3 * (2 + 16) + 1);
+            for (const char* name : {"B", "G", "R"}) {
+                putStr(name);
+                putInt(pixelType);
+                const uint8_t pLinearAndReserved[4] = {0, 0, 0, 0};
+                put(pLinearAndReserved, 4);
+                putInt(1); // xSampling
+                putInt(1); // ySampling
+            }
+            header.push_back(0);
+            attribute("compression", "compression", 1);
+            header.push_back(0); // NO_COMPRESSION
+            for (const char* window : {"dataWindow", "displayWindow"}) {
+                attribute(window, "box2i", 16);
+                putInt(0);
+                putInt(0);
+                putInt(width_ - 1);
+                putInt(height_ - 1);
+            }
+            attribute("lineOrder", "lineOrder", 1);
+            header.push_back(0); // INCREASING_Y
+            float one = 1;
+            attribute("pixelAspectRatio", "float", 4);
+            put(&one, 4);
+            const float center[2] = {0, 0};
+            attribute("screenWindowCenter", "v2f", 8);
+            put(center, 8);
+            attribute("screenWindowWidth", "float", 4);
+            put(&one, 4);
+            header.push_back(0);
+
+            // 偏移表之后依次是各行的块：行号、数据大小、数据
+            int64_t blockSize = 8 + rowBytes();
+            int64_t first     = int64_t(header.size()) + int64_t(height_) * 8;
+            for (int y = 0; y < height_; ++y) {
+                uint64_t offset = first + y * blockSize;
+                put(&offset, 8);
+            }
+            fwrite(header.data(), 1, header.size(), fp_);
+            return blockSize * height_;
+        }
+
+        void writeRow(int x0, int y, int n, const Vector3f* pixels) override {
+            int     bytes = half_ ? 2 : 4;
+            int64_t block = dataOffset_ + y * (8 + rowBytes());
+            // 块头：行号与数据大小，同一行的各个块重复写入相同的内容
+            int32_t prefix[2] = {y, int32_t(rowBytes())};
+            writeAt(block, prefix, 8);
+
+            buffer_.resize(size_t(n) * bytes);
+            for (int c = 0; c < 3; ++c) {
+                int channel = 2 - c; // B, G, R
+                for (int i = 0; i < n; ++i) {
+                    float v = (&pixels[i].x)[channel];
+                    if (half_) {
+                        uint16_t h = floatToHalf(v);
+                        std::memcpy(&buffer_[i * 2], &h, 2);
+                    } else {
+                        std::memcpy(&buffer_[i * 4], &v, 4);
+                    }
+                }
+                int64_t offset = block + 8 + (int64_t(c) * width_ + x0) * bytes;
+                writeAt(offset, buffer_.data(), buffer_.size());
+            }
+        }
+
+      private:
+        auto rowBytes() const -> int64_t { return int64_t(width_) * 3 * (half_ ? 2 : 4); }
+
+        bool half_;
+    };
+} // namespace
+
+ByteEncoder::ByteEncoder(Transfer transfer) : table_((0x3F800000U - MIN_BITS) >> SHIFT) {
+    // start_[b] 为量化结果不小于 b 的最小浮点数，在 [0, 1] 的位模式上二分
+    start_[0] = 0;
+    for (int b = 1; b < 256; ++b) {
+        uint32_t lo = 0;
+        uint32_t hi = 0x3F800000U;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (encodeExact(transfer, bitsToFloat(mid)) >= b) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        start_[b] = bitsToFloat(lo);
+    }
+    start_[256] = std::numeric_limits<float>::infinity();
+    assert(start_[1] >= MIN_VALUE);
+
+    for (uint32_t i = 0; i < table_.size(); ++i) {
+        uint32_t first = MIN_BITS + (i << SHIFT);
+        table_[i]      = uint8_t(encodeExact(transfer, bitsToFloat(first)));
+        // 段内最多跨过一个量化间隔
+        assert(encodeExact(transfer, bitsToFloat(first + (1U << SHIFT) - 1)) <= table_[i] + 1);
+    }
+}
+
+auto ImageWriter::create(ImageFormat format, Transfer transfer) -> std::unique_ptr<ImageWriter> {
+    switch (format) {
+        case ImageFormat::PPM: return std::make_unique<PPMWriter>(transfer);
+        case ImageFormat::PFM: return std::make_unique<PFMWriter>();
+        case ImageFormat::EXR_HALF: return std::make_unique<EXRWriter>(true);
+        case ImageFormat::EXR_FLOAT: return std::make_unique<EXRWriter>(false);
+    }
+    return nullptr;
+}
+
+auto ImageWriter::extension(ImageFormat format) -> std::string_view {
+    switch (format) {
+        case ImageFormat::PPM: return ".ppm";
+        case ImageFormat::PFM: return ".pfm";
+        case ImageFormat::EXR_HALF:
+        case ImageFormat::EXR_FLOAT: return ".exr";
+    }
+    return "";
+}
+
+ImageWriter::~ImageWriter() { close(); }
+
+auto ImageWriter::open(const std::string& filename, int width, int height) -> bool {
+    close();
+    filename_ = filename;
+    width_    = width;
+    height_   = height;
+    ok_       = true;
+    fp_       = fopen(filename.c_str(), "wb");
+    if (fp_ == nullptr) {
+        std::cerr << "Cannot write " << filename << "\n";
+        return false;
+    }
+    int64_t dataSize = writeHeader();
+    dataOffset_      = ftell(fp_);
+    // 预留全部像素数据，未写到的区域保持为 0
+    if (dataSize > 0) {
+        uint8_t zero = 0;
+        writeAt(dataOffset_ + dataSize - 1, &zero, 1);
+    }
+    return ok_;
+}
+
+void ImageWriter::writeTile(const Tile& tile, const Vector3f* pixels, int stride) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fp_ == nullptr) { return; }
+    for (int y = tile.y0; y < tile.y1; ++y) {
+        writeRow(tile.x0, y, tile.width(), pixels + int64_t(y - tile.y0) * stride);
+    }
+}
+
+void ImageWriter::writeAt(int64_t offset, const void* data, size_t size) {
+    if (fseek(fp_, long(offset), SEEK_SET) != 0 || fwrite(data, 1, size, fp_) != size) {
+        ok_ = false;
+    }
+}
+
+auto ImageWriter::close() -> bool {
+    if (fp_ == nullptr) { return ok_; }
+    ok_ = fclose(fp_) == 0 && ok_;
+    fp_ = nullptr;
+    if (!ok_) { std::cerr << "Failed to write " << filename_ << "\n"; }
+    return ok_;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "TileScheduler.hpp"
+#include "Vector.hpp"
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 输出格式。PPM 为 8 位，其余保留浮点数据
+enum class ImageFormat { PPM, PFM, EXR_HALF, EXR_FLOAT };
+
+// 8 位输出使用的传递曲线
+enum class Transfer {
+    GAMMA,  // pow(x, 0.6)，作业框架原有的显示曲线
+    SRGB,   // IEC 61966-2-1
+    LINEAR, // 直接量化，用于法线等非颜色数据
+};
+
+// 按传递曲线把浮点数量化为 8 位
+//
+// [2^-14, 1) 内的浮点数按指数与尾数的高 8 位分段查表得到下界，每段跨过的量化
+// 间隔不超过一个，再与下一个取值的起点比较一次即可。结果与逐像素计算曲线后
+// 截断完全相同，但既不需要计算 pow，也没有难以预测的分支。
+class ByteEncoder {
+  public:
+    explicit ByteEncoder(Transfer transfer);
+
+    auto operator()(float x) const -> uint8_t {
+        if (!(x < 1.F)) { return 255; } // 与 clamp 一致，NaN 也视为 1
+        if (!(x >= MIN_VALUE)) { return 0; }
+        uint32_t bits = 0;
+        std::memcpy(&bits, &x, sizeof(bits));
+        int b = table_[(bits - MIN_BITS) >> SHIFT];
+        return uint8_t(b + int(x >= start_[b + 1]));
+    }
+
+  private:
+    static constexpr uint32_t MIN_BITS  = 0x38800000U; // 2^-14，各曲线量化为 1 的起点都在其上
+    static constexpr float    MIN_VALUE = 6.103515625e-05F;
+    static constexpr int      SHIFT     = 15; // 保留尾数的高 8 位
+
+    std::vector<uint8_t>   table_; // 每段起点的量化结果
+    std::array<float, 257> start_; // 量化结果不小于 b 的最小浮点数，start_[256] 为无穷大
+};
+
+// 图像输出
+//
+// 打开时写出文件头并预留全部像素数据的空间，之后每个块完成时即可写到它在文件中
+// 的位置，不需要在内存中保存整幅 8 位图像。所有格式按小端序写出。
+class ImageWriter {
+  public:
+    // transfer 只对 8 位格式有效
+    static auto create(ImageFormat format, Transfer transfer = Transfer::GAMMA)
+        -> std::unique_ptr<ImageWriter>;
+    // 文件扩展名，包含点号
+    static auto extension(ImageFormat format) -> std::string_view;
+
+    ImageWriter(const ImageWriter&)                    = delete;
+    auto operator=(const ImageWriter&) -> ImageWriter& = delete;
+    virtual ~ImageWriter();
+
+    auto open(const std::string& filename, int width, int height) -> bool;
+    // 写出一个块，pixels 指向块的左上角，stride 为相邻两行的间距（像素）。线程安全
+    void writeTile(const Tile& tile, const Vector3f* pixels, int stride);
+    // 写出整幅图像
+    void write(const std::vector<Vector3f>& image) {
+        writeTile({0, 0, width_, height_}, image.data(), width_);
+    }
+    auto close() -> bool;
+
+  protected:
+    ImageWriter() = default;
+
+    // 写出文件头，返回像素数据的总字节数
+    virtual auto writeHeader() -> int64_t = 0;
+    // 把第 y 行从 x0 开始的 n 个像素写到文件中
+    virtual void writeRow(int x0, int y, int n, const Vector3f* pixels) = 0;
+
+    void writeAt(int64_t offset, const void* data, size_t size);
+
+    FILE*                fp_         = nullptr;
+    int                  width_      = 0;
+    int                  height_     = 0;
+    int64_t              dataOffset_ = 0; // 像素数据的起始位置
+    std::vector<uint8_t> buffer_;         // 一行的编码结果，只在持有锁时使用
+
+  private:
+    std::mutex  mutex_;
+    std::string filename_;
+    bool        ok_ = true;
+};
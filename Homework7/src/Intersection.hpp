@@ -6,6 +6,8 @@
 #define RAYTRACING_INTERSECTION_H
 #include "Material.hpp"
 #include "Vector.hpp"
+#include <cstdint>
+#include <limits>
 class Object;
 class Sphere;
 
@@ -14,7 +16,7 @@ struct Intersection {
         happened = false;
         coords   = Vector3f();
         normal   = Vector3f();
-        distance = std::numeric_limits<double>::max();
+        distance = std::numeric_limits<float>::infinity();
         obj      = nullptr;
         m        = nullptr;
     }
@@ -23,8 +25,18 @@ struct Intersection {
     Vector3f  tcoords;
     Vector3f  normal;
     Vector3f  emit;
-    double    distance;
+    float     distance; // 交点处光线的参数 t
     Object*   obj;
     Material* m;
 };
+
+// 求交时传递的精简命中记录，完整的 Intersection 只对最终的最近交点构造
+struct HitRecord {
+    float    t = std::numeric_limits<float>::infinity(); // 光线参数，同时是继续搜索的上限
+    int32_t  prim = -1;         // 图元在所属 BVH 中的下标，三角形网格中为三角形的下标
+    Vector2f uv;                // 三角形的重心坐标
+    Object*  object   = nullptr; // 命中的图元
+    Object*  instance = nullptr; // 图元所在的实例，光线需要先变换到它的物体空间
+    Object*  root     = nullptr; // 最外层 BVH 中被命中的图元，即场景中的顶层物体
+};
 #endif // RAYTRACING_INTERSECTION_H
@@ -8,7 +8,9 @@
 #include "Vector.hpp"
 #include "global.hpp"
 
-enum MaterialType { DIFFUSE };
+// DIFFUSE: Lambert 漫反射
+// MICROFACET: 漫反射 Kd 加 GGX 微表面镜面反射，Ks 为垂直入射时的菲涅尔反射率
+enum MaterialType { DIFFUSE, MICROFACET };
 
 class Material {
   private:
@@ -88,6 +90,38 @@ class Material {
         return a.x * B + a.y * C + a.z * N;
     }
 
+    // 按余弦加权在半球上采样，pdf = cos / PI
+    auto sampleCosine(const Vector3f& N) -> Vector3f {
+        float x_1 = get_random_float();
+        float x_2 = get_random_float();
+        float r   = std::sqrt(x_1);
+        float phi = 2 * M_PI * x_2;
+        return toWorld(Vector3f(r * std::cos(phi), r * std::sin(phi), std::sqrt(1.0F - x_1)), N);
+    }
+
+    // GGX 法线分布 D(h)，cosH 为半程向量与法线的夹角余弦
+    static auto ggxD(float cosH, float alpha) -> float {
+        float a2 = alpha * alpha;
+        float d  = cosH * cosH * (a2 - 1) + 1;
+        return a2 / (M_PI * d * d);
+    }
+
+    // Smith 单向遮蔽函数
+    static auto smithG1(float cosV, float alpha) -> float {
+        float a2 = alpha * alpha;
+        return 2 * cosV / (cosV + std::sqrt(a2 + (1 - a2) * cosV * cosV));
+    }
+
+    // GGX 的 alpha 取粗糙度的平方，粗糙度在感知上更接近线性
+    auto alpha() const -> float { return std::max(roughness * roughness, 1e-3F); }
+
+    // 采样镜面反射波瓣的概率，按两个波瓣反射率的比例
+    auto specularProbability() const -> float {
+        float ks = Ks.x + Ks.y + Ks.z;
+        float kd = Kd.x + Kd.y + Kd.z;
+        return ks + kd > 0 ? ks / (ks + kd) : 0.5F;
+    }
+
   public:
     MaterialType m_type;
     // Vector3f m_color;
@@ -95,6 +129,7 @@ class Material {
     float    ior;
     Vector3f Kd, Ks;
     float    specularExponent;
+    float    roughness = 0.3F; // MICROFACET 的粗糙度
     // Texture tex;
 
     inline Material(MaterialType t = DIFFUSE, Vector3f e = Vector3f(0, 0, 0));
@@ -103,6 +138,8 @@ class Material {
     static inline auto getColorAt(double u, double v) -> Vector3f;
     inline auto        getEmission() const -> Vector3f;
     inline auto        hasEmission() -> bool;
+    // 表面的反照率，降噪时用它把纹理、材质与光照分开
+    inline auto albedo() const -> Vector3f;
 
     // sample a ray by Material properties
     inline auto sample(const Vector3f& wi, const Vector3f& N) -> Vector3f;
@@ -124,48 +161,84 @@ auto Material::hasEmission() -> bool { return m_emission.norm() > EPSILON; }
 
 auto Material::getColorAt(double u, double v) -> Vector3f { return {}; }
 
+auto Material::albedo() const -> Vector3f {
+    switch (m_type) {
+        case DIFFUSE: {
+            return Kd;
+        }
+        case MICROFACET: {
+            // 垂直入射时镜面波瓣的反射率为 Ks
+            return Vector3f::Min(Kd + Ks, Vector3f(1.0F));
+        }
+    }
+    return {0.0F};
+}
+
 auto Material::sample(const Vector3f& wi, const Vector3f& N) -> Vector3f {
     switch (m_type) {
         case DIFFUSE: {
-            // uniform sample on the hemisphere
-            float    x_1 = get_random_float();
-            float    x_2 = get_random_float();
-            float    z   = std::fabs(1.0F - 2.0F * x_1);
-            float    r   = std::sqrt(1.0F - z * z);
-            float    phi = 2 * M_PI * x_2;
-            Vector3f localRay(r * std::cos(phi), r * std::sin(phi), z);
-            return toWorld(localRay, N);
-
-            break;
+            // cosine-weighted sample on the hemisphere
+            return sampleCosine(N);
+        }
+        case MICROFACET: {
+            if (get_random_float() >= specularProbability()) { return sampleCosine(N); }
+            // 按 D(h) cos(theta_h) 采样半程向量，再把入射方向关于它反射
+            float    a2    = alpha() * alpha();
+            float    x_1   = get_random_float();
+            float    x_2   = get_random_float();
+            float    cos2  = (1 - x_1) / (1 + (a2 - 1) * x_1);
+            float    cosT  = std::sqrt(cos2);
+            float    sinT  = std::sqrt(std::max(0.F, 1 - cos2));
+            float    phi   = 2 * M_PI * x_2;
+            Vector3f h     = toWorld(Vector3f(sinT * std::cos(phi), sinT * std::sin(phi), cosT), N);
+            return reflect(wi, h);
         }
     }
+    return {};
 }
 
 // 计算在给定传入光线方向“wi”和表面法线“N”的情况下对给定出射光线方向“wo”进行采样的概率密度函数
 auto Material::pdf(const Vector3f& wi, const Vector3f& wo, const Vector3f& N) const -> float {
+    float cosO = dotProduct(wo, N);
+    if (cosO <= 0.0F) { return 0.0F; }
     switch (m_type) {
         case DIFFUSE: {
-            // uniform sample probability 1 / (2 * PI)
-            if (dotProduct(wo, N) > 0.0F) { return 0.5F / M_PI; }
-            return 0.0F;
-            break;
+            // cosine-weighted sample probability cos / PI
+            return cosO / M_PI;
+        }
+        case MICROFACET: {
+            // 半程向量的密度 D(h) cos(theta_h) 换算到出射方向需要除以 4 (wo . h)
+            Vector3f h       = normalize(wo - wi);
+            float    cosH    = dotProduct(h, N);
+            float    pdfSpec = ggxD(cosH, alpha()) * cosH / (4 * dotProduct(wo, h));
+            float    pSpec   = specularProbability();
+            return pSpec * std::max(pdfSpec, 0.F) + (1 - pSpec) * cosO / M_PI;
         }
     }
+    return 0.0F;
 }
 
 auto Material::eval(const Vector3f& wi, const Vector3f& wo, const Vector3f& N) -> Vector3f {
+    // calculate the contribution of diffuse model
+    float cosO = dotProduct(N, wo);
+    if (cosO <= 0.0F) { return {0.0F}; }
+    Vector3f diffuse = Kd / M_PI;
     switch (m_type) {
         case DIFFUSE: {
-            // calculate the contribution of diffuse model
-            float cosalpha = dotProduct(N, wo);
-            if (cosalpha > 0.0F) {
-                Vector3f diffuse = Kd / M_PI;
-                return diffuse;
-            }
-            return {0.0F};
-            break;
+            return diffuse;
+        }
+        case MICROFACET: {
+            // Cook-Torrance：D G F / (4 cos_i cos_o)，菲涅尔项用 Schlick 近似
+            float cosI = -dotProduct(N, wi);
+            if (cosI <= 0.0F) { return diffuse; }
+            Vector3f h    = normalize(wo - wi);
+            float    cosD = std::clamp(dotProduct(wo, h), 0.F, 1.F);
+            float    G    = smithG1(cosI, alpha()) * smithG1(cosO, alpha());
+            Vector3f F    = Ks + (Vector3f(1.0F) - Ks) * std::pow(1 - cosD, 5.F);
+            return diffuse + F * (ggxD(dotProduct(h, N), alpha()) * G / (4 * cosI * cosO));
         }
     }
+    return {0.0F};
 }
 
 #endif // RAYTRACING_MATERIAL_H
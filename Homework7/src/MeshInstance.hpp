@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Material.hpp"
+#include "Object.hpp"
+#include "Transform.hpp"
+#include "Triangle.hpp"
+
+// 网格实例
+//
+// 两层加速结构中的顶层图元：每个 MeshTriangle 在构造时建好自己的底层 BVH，
+// 实例只保存对网格的引用与物体到世界的变换，求交时把光线变换到物体空间。
+// 同一网格放置多次只需存一份三角形与 BVH；实例移动后只需重建场景的顶层 BVH。
+class MeshInstance : public Object {
+  public:
+    // mt 为空时沿用网格的材质
+    MeshInstance(MeshTriangle* mesh, const Transform& objectToWorld, Material* mt = nullptr)
+        : mesh_(mesh), m_(mt) {
+        setTransform(objectToWorld);
+    }
+
+    void setTransform(const Transform& objectToWorld) {
+        objectToWorld_ = objectToWorld;
+        worldToObject_ = objectToWorld.Inverse();
+        bounds_        = objectToWorld_(mesh_->getBounds());
+        area_          = 0;
+        for (uint32_t i = 0; i < mesh_->numTriangles; ++i) {
+            auto     tri  = mesh_->triangleVertices(i);
+            Vector3f v0   = objectToWorld_.ApplyPoint(tri[0]);
+            Vector3f v1   = objectToWorld_.ApplyPoint(tri[1]);
+            Vector3f v2   = objectToWorld_.ApplyPoint(tri[2]);
+            area_        += crossProduct(v1 - v0, v2 - v0).norm() * 0.5F;
+        }
+    }
+
+    auto intersect(const Ray& ray) -> bool override {
+        float scale = 0;
+        return mesh_->intersect(toObject(ray, scale));
+    }
+
+    auto intersect(const Ray& /*ray*/, float& /*tnear*/, uint32_t& /*index*/) const
+        -> bool override {
+        return false;
+    }
+
+    auto getIntersection(Ray ray) -> Intersection override {
+        HitRecord hit;
+        if (!closestHit(ray, hit)) { return {}; }
+        return getIntersection(ray, hit);
+    }
+
+    // 在物体空间中求交，命中的参数 t 换算回世界空间，交点所在的图元留到最后再构造
+    auto closestHit(const Ray& ray, HitRecord& hit) -> bool override {
+        float scale = 0;
+        Ray   local = toObject(ray, scale);
+        local.t_max = std::min(ray.t_max, hit.t) * scale;
+        HitRecord localHit;
+        localHit.t = local.t_max;
+        if (!mesh_->closestHit(local, localHit)) { return false; }
+        hit          = localHit;
+        hit.t        = localHit.t / scale;
+        hit.instance = this;
+        return true;
+    }
+
+    auto getIntersection(const Ray& ray, const HitRecord& hit) -> Intersection override {
+        float     scale    = 0;
+        Ray       local    = toObject(ray, scale);
+        HitRecord localHit = hit;
+        localHit.t         = hit.t * scale;
+        localHit.instance  = nullptr;
+        Intersection isect = localHit.object->getIntersection(local, localHit);
+        isect.distance     = hit.t;
+        isect.coords       = ray(hit.t);
+        isect.normal       = normalize(objectToWorld_.ApplyNormal(isect.normal));
+        isect.m            = material();
+        return isect;
+    }
+
+    void getSurfaceProperties(const Vector3f& /*P*/, const Vector3f& /*I*/,
+                              const uint32_t& /*index*/, const Vector2f& /*uv*/, Vector3f& /*N*/,
+                              Vector2f& /*st*/) const override {}
+
+    auto evalDiffuseColor(const Vector2f& st) const -> Vector3f override {
+        return mesh_->evalDiffuseColor(st);
+    }
+
+    auto getBounds() -> Bounds3 override { return bounds_; }
+    auto getArea() -> float override { return area_; }
+
+    // 在网格上按物体空间的面积采样后变换到世界空间。
+    // 概率密度按世界空间面积给出，只在相似变换（均匀缩放）下严格成立
+    void Sample(Intersection& pos, float& pdf) override {
+        mesh_->Sample(pos, pdf);
+        pos.coords = objectToWorld_.ApplyPoint(pos.coords);
+        pos.normal = normalize(objectToWorld_.ApplyNormal(pos.normal));
+        pos.emit   = material()->getEmission();
+        pdf        = 1.F / area_;
+    }
+
+    auto hasEmit() -> bool override { return material()->hasEmission(); }
+
+    void getEmissiveTriangles(std::vector<EmissiveTriangle>& out) override {
+        if (!hasEmit()) { return; }
+        for (uint32_t i = 0; i < mesh_->numTriangles; ++i) {
+            auto     tri = mesh_->triangleVertices(i);
+            Vector3f v0  = objectToWorld_.ApplyPoint(tri[0]);
+            Vector3f e1  = objectToWorld_.ApplyPoint(tri[1]) - v0;
+            Vector3f e2  = objectToWorld_.ApplyPoint(tri[2]) - v0;
+            Vector3f n   = crossProduct(e1, e2);
+            out.push_back({v0, e1, e2, normalize(n), material()->getEmission(), n.norm() * 0.5F});
+        }
+    }
+
+  private:
+    // 变换到物体空间并归一化方向，三角形求交中的行列式阈值依赖方向的长度。
+    // scale 为物体空间与世界空间光线参数之比
+    auto toObject(const Ray& ray, float& scale) const -> Ray {
+        Ray      r = worldToObject_(ray);
+        Vector3f d = r.direction;
+        scale      = d.norm();
+        Ray local(r.origin, d / scale);
+        local.t_min = ray.t_min * scale;
+        local.t_max = ray.t_max * scale;
+        return local;
+    }
+
+    auto material() const -> Material* { return m_ != nullptr ? m_ : mesh_->m; }
+
+    MeshTriangle* mesh_;
+    Material*     m_;
+    Transform     objectToWorld_;
+    Transform     worldToObject_;
+    Bounds3       bounds_;
+    float         area_ = 0;
+};
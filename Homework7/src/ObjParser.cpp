@@ -0,0 +1,287 @@
+#include "ObjParser.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+    // 每块至少这么多字节，小文件不切分
+    constexpr size_t  MIN_CHUNK_SIZE = size_t(1) << 20;
+    constexpr int64_t NONE           = std::numeric_limits<int64_t>::min();
+
+    // 面中一个角点在 v、vt、vn 中的下标，没有给出时为 NONE。
+    // 负数的相对下标在解析时只知道本块中已有的数量，relative 的对应位为 1，
+    // 合并时再加上之前各块的数量
+    struct Corner {
+        int64_t index[3];
+        uint8_t relative;
+    };
+
+    // 一块文本的解析结果，面已经三角化，corners 中每三个构成一个三角形
+    struct Chunk {
+        std::vector<MeshFile::Float3> positions;
+        std::vector<MeshFile::Float2> texCoords;
+        std::vector<MeshFile::Float3> normals;
+        std::vector<Corner>           corners;
+        bool                          ok = true;
+
+        auto count(int attribute) const -> int64_t {
+            size_t sizes[3] = {positions.size(), texCoords.size(), normals.size()};
+            return int64_t(sizes[attribute]);
+        }
+    };
+
+    auto isSpace(char c) -> bool { return c == ' ' || c == '\t'; }
+
+    auto skipSpaces(const char* p, const char* end) -> const char* {
+        while (p < end && isSpace(*p)) { ++p; }
+        return p;
+    }
+
+    // from_chars 不接受前导的 +
+    auto parseFloat(const char*& p, const char* end, float& value) -> bool {
+        p = skipSpaces(p, end);
+        if (p < end && *p == '+') { ++p; }
+        auto [next, error] = std::from_chars(p, end, value);
+        p                  = next;
+        return error == std::errc();
+    }
+
+    // 解析 v、v/vt、v//vn 或 v/vt/vn 形式的角点
+    auto parseCorner(const char*& p, const char* end, const Chunk& chunk, Corner& corner) -> bool {
+        corner = {{NONE, NONE, NONE}, 0};
+        for (int a = 0; a < 3; ++a) {
+            if (a > 0) {
+                if (p >= end || *p != '/') { break; }
+                ++p;
+                // v//vn 中的 vt 为空
+                if (a == 1 && p < end && *p == '/') { continue; }
+            }
+            int64_t value      = 0;
+            auto [next, error] = std::from_chars(p, end, value);
+            if (error != std::errc() || value == 0) { return false; }
+            p = next;
+            if (value > 0) {
+                corner.index[a] = value - 1;
+            } else {
+                corner.index[a]  = chunk.count(a) + value;
+                corner.relative |= 1U << a;
+            }
+        }
+        return p == end || isSpace(*p);
+    }
+
+    // 语句名后面必须是空白或行尾
+    auto isKeyword(const char* p, const char* end, const char* keyword) -> bool {
+        size_t n = std::strlen(keyword);
+        return size_t(end - p) >= n && std::memcmp(p, keyword, n) == 0 &&
+               (size_t(end - p) == n || isSpace(p[n]));
+    }
+
+    auto parseLine(const char* p, const char* end, Chunk& chunk, std::vector<Corner>& polygon)
+        -> bool {
+        if (isKeyword(p, end, "v")) {
+            p += 1;
+            MeshFile::Float3 v{};
+            bool ok = parseFloat(p, end, v.x) && parseFloat(p, end, v.y) &&
+                      parseFloat(p, end, v.z);
+            chunk.positions.push_back(v);
+            return ok;
+        }
+        if (isKeyword(p, end, "vt")) {
+            // 第二个坐标可以省略
+            MeshFile::Float2 t{};
+            p       += 2;
+            bool ok  = parseFloat(p, end, t.x);
+            p        = skipSpaces(p, end);
+            if (ok && p < end) { ok = parseFloat(p, end, t.y); }
+            chunk.texCoords.push_back(t);
+            return ok;
+        }
+        if (isKeyword(p, end, "vn")) {
+            p += 2;
+            MeshFile::Float3 n{};
+            bool ok = parseFloat(p, end, n.x) && parseFloat(p, end, n.y) &&
+                      parseFloat(p, end, n.z);
+            chunk.normals.push_back(n);
+            return ok;
+        }
+        if (isKeyword(p, end, "f")) {
+            polygon.clear();
+            p = skipSpaces(p + 1, end);
+            while (p < end) {
+                polygon.emplace_back();
+                if (!parseCorner(p, end, chunk, polygon.back())) { return false; }
+                p = skipSpaces(p, end);
+            }
+            // 以第一个角点为中心扇形三角化，三角形数与角点数成线性
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+        // 其余语句（o、g、usemtl、注释等）忽略
+        return true;
+    }
+
+    void parseChunk(const char* begin, const char* end, Chunk& chunk) {
+        std::vector<Corner> polygon;
+        const char*         p = begin;
+        while (p < end && chunk.ok) {
+            const auto* lineEnd = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+            if (lineEnd == nullptr) { lineEnd = end; }
+            const char* next = lineEnd < end ? lineEnd + 1 : end;
+            if (lineEnd > p && lineEnd[-1] == '\r') { --lineEnd; }
+            chunk.ok = parseLine(skipSpaces(p, lineEnd), lineEnd, chunk, polygon);
+            p        = next;
+        }
+    }
+
+    // 下标解析完之后按 v/vt/vn 组合去重
+    struct CornerEqual {
+        auto operator()(const Corner& a, const Corner& b) const -> bool {
+            return std::equal(a.index, a.index + 3, b.index);
+        }
+    };
+
+    struct CornerHash {
+        auto operator()(const Corner& corner) const -> size_t {
+            uint64_t h = 0;
+            for (int64_t i : corner.index) { h = (h ^ uint64_t(i)) * 0x9E3779B97F4A7C15ULL; }
+            return size_t(h ^ (h >> 32));
+        }
+    };
+} // namespace
+
+auto loadObj(const std::string& filename, ObjMesh& mesh, int nThreads) -> bool {
+    MappedFile file;
+    if (!file.open(filename)) {
+        fprintf(stderr, "Cannot open %s\n", filename.c_str());
+        return false;
+    }
+    if (nThreads <= 0) { nThreads = int(std::max(1U, std::thread::hardware_concurrency())); }
+
+    // 按行切块，每个线程分到若干块
+    const char* text    = reinterpret_cast<const char*>(file.data());
+    const char* textEnd = text + file.size();
+    int         nChunks = int(std::clamp(file.size() / MIN_CHUNK_SIZE, size_t(1),
+                                         size_t(nThreads) * 4));
+    std::vector<const char*> bounds(nChunks + 1, textEnd);
+    bounds[0] = text;
+    for (int c = 1; c < nChunks; ++c) {
+        const char* p  = std::max(text + file.size() * c / nChunks, bounds[c - 1]);
+        const auto* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(textEnd - p)));
+        bounds[c]      = nl != nullptr ? nl + 1 : textEnd;
+    }
+    std::vector<Chunk> chunks(nChunks);
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+    for (int c = 0; c < nChunks; ++c) { parseChunk(bounds[c], bounds[c + 1], chunks[c]); }
+
+    // 各块的 v、vt、vn 与角点依次排列，前缀和给出它们在合并结果中的起点
+    std::vector<std::array<int64_t, 4>> offsets(nChunks + 1, {0, 0, 0, 0});
+    for (int c = 0; c < nChunks; ++c) {
+        if (!chunks[c].ok) {
+            fprintf(stderr, "Cannot parse %s\n", filename.c_str());
+            return false;
+        }
+        for (int a = 0; a < 3; ++a) { offsets[c + 1][a] = offsets[c][a] + chunks[c].count(a); }
+        offsets[c + 1][3] = offsets[c][3] + int64_t(chunks[c].corners.size());
+    }
+    const auto& totals = offsets[nChunks];
+    if (totals[3] > int64_t(std::numeric_limits<uint32_t>::max())) {
+        fprintf(stderr, "Too many vertices in %s\n", filename.c_str());
+        return false;
+    }
+    // 第一个角点给出 vt、vn 的有无。每个角点的 vt、vn 都与 v 同号（或都没有）时，
+    // 顶点就是 v 本身，不需要去重
+    bool hasTexCoords = false;
+    bool hasNormals   = false;
+    for (const Chunk& chunk : chunks) {
+        if (chunk.corners.empty()) { continue; }
+        hasTexCoords = chunk.corners[0].index[1] != NONE;
+        hasNormals   = chunk.corners[0].index[2] != NONE;
+        break;
+    }
+
+    std::vector<MeshFile::Float3> positions(totals[0]);
+    std::vector<MeshFile::Float2> texCoords(totals[1]);
+    std::vector<MeshFile::Float3> normals(totals[2]);
+    bool                          valid  = true;
+    bool                          direct = true;
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1) reduction(&& : valid, direct)
+    for (int c = 0; c < nChunks; ++c) {
+        Chunk& chunk = chunks[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(),
+                  positions.begin() + offsets[c][0]);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(),
+                  texCoords.begin() + offsets[c][1]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + offsets[c][2]);
+        // 相对下标加上之前各块的数量，原地改为绝对下标
+        for (Corner& corner : chunk.corners) {
+            for (int a = 0; a < 3; ++a) {
+                if ((corner.relative >> a) & 1U) { corner.index[a] += offsets[c][a]; }
+                int64_t index = corner.index[a];
+                valid         = valid && (index == NONE || (index >= 0 && index < totals[a]));
+            }
+            corner.relative = 0;
+            valid           = valid && corner.index[0] != NONE;
+            direct = direct && corner.index[1] == (hasTexCoords ? corner.index[0] : NONE) &&
+                     corner.index[2] == (hasNormals ? corner.index[0] : NONE);
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "Invalid face index in %s\n", filename.c_str());
+        return false;
+    }
+
+    mesh.indices.resize(totals[3]);
+    if (direct) {
+        mesh.normals.assign(positions.size(), {0, 0, 0});
+        mesh.texCoords.assign(positions.size(), {0, 0});
+        if (hasNormals) {
+            std::copy_n(normals.begin(), std::min(normals.size(), positions.size()),
+                        mesh.normals.begin());
+        }
+        if (hasTexCoords) {
+            std::copy_n(texCoords.begin(), std::min(texCoords.size(), positions.size()),
+                        mesh.texCoords.begin());
+        }
+        mesh.positions = std::move(positions);
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+        for (int c = 0; c < nChunks; ++c) {
+            const auto& corners = chunks[c].corners;
+            for (size_t i = 0; i < corners.size(); ++i) {
+                mesh.indices[offsets[c][3] + int64_t(i)] = uint32_t(corners[i].index[0]);
+            }
+        }
+        return true;
+    }
+
+    // 一般情况按 v/vt/vn 组合去重，顶点按首次出现的顺序排列
+    std::unordered_map<Corner, uint32_t, CornerHash, CornerEqual> vertexIds;
+    vertexIds.reserve(std::min(size_t(totals[3]), positions.size() * 2));
+    mesh.positions.clear();
+    mesh.normals.clear();
+    mesh.texCoords.clear();
+    size_t next = 0;
+    for (const Chunk& chunk : chunks) {
+        for (const Corner& corner : chunk.corners) {
+            auto [it, inserted] = vertexIds.try_emplace(corner, uint32_t(mesh.positions.size()));
+            if (inserted) {
+                const int64_t* index = corner.index;
+                mesh.positions.push_back(positions[index[0]]);
+                mesh.texCoords.push_back(index[1] != NONE ? texCoords[index[1]]
+                                                          : MeshFile::Float2{0, 0});
+                mesh.normals.push_back(index[2] != NONE ? normals[index[2]]
+                                                        : MeshFile::Float3{0, 0, 0});
+            }
+            mesh.indices[next++] = it->second;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "MeshFile.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 从 OBJ 读出的网格，v/vt/vn 组合相同的角点共用一个顶点
+struct ObjMesh {
+    std::vector<MeshFile::Float3> positions;
+    std::vector<MeshFile::Float3> normals;   // 没有 vn 的角点为 0
+    std::vector<MeshFile::Float2> texCoords; // 没有 vt 的角点为 0
+    std::vector<uint32_t>         indices;   // 每三个构成一个三角形，顺序与文件中的面一致
+
+    auto triangleCount() const -> size_t { return indices.size() / 3; }
+};
+
+// 读取 OBJ 文件中的 v、vt、vn 与 f，其余语句忽略，所有对象合并为一个网格。
+// 文件映射到内存后按行切成若干块并行解析，多边形按扇形三角化（要求为凸多边形）。
+// nThreads 为 0 时使用全部核心。文件无法读取或格式错误时返回 false
+auto loadObj(const std::string& filename, ObjMesh& mesh, int nThreads = 0) -> bool;
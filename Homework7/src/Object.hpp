@@ -9,6 +9,17 @@
 #    include "Intersection.hpp"
 #    include "Ray.hpp"
 #    include "Vector.hpp"
+#    include <algorithm>
+#    include <array>
+#    include <vector>
+
+// 世界空间中的发光三角形，场景据此建立光源分布
+struct EmissiveTriangle {
+    Vector3f v0, e1, e2; // 顶点与两条边 v1 - v0, v2 - v0
+    Vector3f normal;
+    Vector3f emission;
+    float    area;
+};
 
 class Object {
   public:
@@ -24,6 +35,25 @@ class Object {
     virtual auto getArea() -> float                                                = 0;
     virtual void Sample(Intersection& pos, float& pdf)                             = 0;
     virtual auto hasEmit() -> bool                                                 = 0;
+    // 三角形返回 true 并给出三个顶点，BVH 据此把叶子打包成 SoA 三角形块
+    virtual auto getVertices(std::array<Vector3f, 3>& /*v*/) const -> bool { return false; }
+    // 自发光物体把组成自己的三角形追加到 out 中，不由三角形组成的物体什么也不做
+    virtual void getEmissiveTriangles(std::vector<EmissiveTriangle>& /*out*/) {}
+    // 最近交点查询：只在 [t_min, hit.t) 内寻找更近的交点，找到时更新 hit 并返回 true。
+    // 默认通过 getIntersection 求交
+    virtual auto closestHit(const Ray& ray, HitRecord& hit) -> bool {
+        Ray r(ray);
+        r.t_max        = std::min(ray.t_max, hit.t);
+        Intersection h = getIntersection(r);
+        if (!h.happened || h.distance >= hit.t) { return false; }
+        hit.t      = h.distance;
+        hit.object = this;
+        return true;
+    }
+    // 由 closestHit 得到的命中记录构造完整的交点，默认重新求交
+    virtual auto getIntersection(const Ray& ray, const HitRecord& /*hit*/) -> Intersection {
+        return getIntersection(ray);
+    }
 };
 
 #endif // RAYTRACING_OBJECT_H
@@ -0,0 +1,193 @@
+#include "Options.hpp"
+#include "WideBVH.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <string_view>
+
+namespace {
+    // 各数值选项的上限，防止像素数溢出或一次申请过多的线程与内存
+    constexpr int MAX_IMAGE_SIZE = 16384;
+    constexpr int MAX_THREADS    = 1024;
+    constexpr int MAX_INSTANCES  = 1 << 20;
+
+    auto checkRange(const char* name, int value, int low, int high) -> bool {
+        if (value >= low && value <= high) { return true; }
+        std::cerr << name << " must be between " << low << " and " << high << "\n";
+        return false;
+    }
+} // namespace
+
+auto parseOptions(int argc, const char* const* argv, RenderOptions& options,
+                  SceneOptions& sceneOptions) -> bool {
+    for (int i = 1; i < argc; i += 2) {
+        std::string_view key = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << key << "\n";
+            return false;
+        }
+        const char* value = argv[i + 1];
+        if (key == "--spp") {
+            options.spp = std::atoi(value);
+        } else if (key == "--threads") {
+            options.threads = std::atoi(value);
+        } else if (key == "--tile") {
+            options.tileSize = std::atoi(value);
+        } else if (key == "--depth") {
+            options.maxDepth = std::atoi(value);
+        } else if (key == "--wavefront") {
+            options.wavefront = std::atoi(value);
+        } else if (key == "--noise") {
+            options.noiseThreshold = float(std::atof(value));
+        } else if (key == "--batch") {
+            options.batch = std::atoi(value);
+        } else if (key == "--time") {
+            options.timeBudget = float(std::atof(value));
+        } else if (key == "--simd") {
+            // 只能选择 CPU 支持的级别
+            std::string_view name  = value;
+            SimdLevel        level = name == "avx2" ? SimdLevel::AVX2
+                                     : name == "sse" ? SimdLevel::SSE
+                                                     : SimdLevel::SCALAR;
+            sceneOptions.simd      = std::min(level, detectSimdLevel());
+        } else if (key == "--bvh-build") {
+            std::string_view name = value;
+            if (name == "sah") {
+                sceneOptions.bvhBuild = BVHAccel::SplitMethod::SAH;
+            } else if (name == "lbvh") {
+                sceneOptions.bvhBuild = BVHAccel::SplitMethod::LBVH;
+            } else {
+                std::cerr << "Unknown BVH build method " << name << "\n";
+                return false;
+            }
+        } else if (key == "--bvh-cache") {
+            sceneOptions.bvhCache = std::atoi(value) != 0;
+        } else if (key == "--instances") {
+            sceneOptions.instances = std::atoi(value);
+        } else if (key == "--glossy") {
+            sceneOptions.glossy = float(std::atof(value));
+        } else if (key == "--mis") {
+            sceneOptions.mis = std::atoi(value) != 0;
+        } else if (key == "--width") {
+            sceneOptions.width = std::atoi(value);
+        } else if (key == "--height") {
+            sceneOptions.height = std::atoi(value);
+        } else if (key == "--fov") {
+            sceneOptions.fov = float(std::atof(value));
+        } else if (key == "--eye") {
+            Vector3f& eye = sceneOptions.eye;
+            if (std::sscanf(value, "%f,%f,%f", &eye.x, &eye.y, &eye.z) != 3) {
+                std::cerr << "Invalid camera position " << value << "\n";
+                return false;
+            }
+        } else if (key == "--denoise") {
+            options.denoise = std::atoi(value);
+        } else if (key == "--aov") {
+            // 逗号分隔的 AOV 名称，all 表示全部
+            std::string_view list = value;
+            while (!list.empty()) {
+                std::string_view name = list.substr(0, list.find(','));
+                list.remove_prefix(std::min(list.size(), name.size() + 1));
+                int a = 0;
+                while (a < int(AOV::COUNT) && name != AOV_NAMES[a]) { ++a; }
+                if (name == "all") {
+                    options.aovs = (1U << int(AOV::COUNT)) - 1;
+                } else if (a < int(AOV::COUNT)) {
+                    options.aovs |= 1U << a;
+                } else {
+                    std::cerr << "Unknown AOV " << name << "\n";
+                    return false;
+                }
+            }
+        } else if (key == "--format") {
+            std::string_view name = value;
+            if (name == "ppm") {
+                options.format = ImageFormat::PPM;
+            } else if (name == "pfm") {
+                options.format = ImageFormat::PFM;
+            } else if (name == "exr") {
+                options.format = ImageFormat::EXR_FLOAT;
+            } else if (name == "exr-half") {
+                options.format = ImageFormat::EXR_HALF;
+            } else {
+                std::cerr << "Unknown image format " << name << "\n";
+                return false;
+            }
+        } else if (key == "--srgb") {
+            options.srgb = std::atoi(value) != 0;
+        } else if (key == "--reference") {
+            options.reference = value;
+        } else if (key == "--output") {
+            options.output = value;
+        } else if (key == "--checkpoint") {
+            options.checkpoint = value;
+        } else if (key == "--checkpoint-interval") {
+            options.checkpointInterval = float(std::atof(value));
+        } else if (key == "--resume") {
+            // 继续写同一个断点文件
+            options.checkpoint = value;
+            options.resume     = true;
+        } else if (key == "--workers") {
+            options.workers = std::atoi(value);
+        } else if (key == "--worker") {
+            // 协调进程启动工作进程时追加的参数，形如 k/n
+            if (std::sscanf(value, "%d/%d", &options.workerIndex, &options.workerCount) != 2 ||
+                options.workerIndex < 0 || options.workerIndex >= options.workerCount) {
+                std::cerr << "Invalid worker " << value << "\n";
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option " << key << "\n"
+                      << "Usage: " << argv[0]
+                      << " [--spp N] [--threads N] [--tile N] [--depth N] [--wavefront N]"
+                      << " [--noise F] [--batch N] [--time S] [--simd scalar|sse|avx2]"
+                      << " [--bvh-build sah|lbvh] [--bvh-cache 0|1]"
+                      << " [--instances N] [--glossy R] [--mis 0|1] [--width N] [--height N]"
+                      << " [--fov DEG] [--eye X,Y,Z] [--denoise N]"
+                      << " [--aov normal,albedo,depth,id,samples|all]"
+                      << " [--format ppm|pfm|exr|exr-half] [--srgb 0|1] [--output BASE]"
+                      << " [--reference FILE] [--checkpoint FILE] [--checkpoint-interval S]"
+                      << " [--resume FILE] [--workers N]\n"
+                      << "       " << argv[0] << " --server PORT [options]\n";
+            return false;
+        }
+    }
+    if (options.spp < 1) {
+        std::cerr << "--spp must be at least 1\n";
+        return false;
+    }
+    if (options.tileSize < 1) {
+        std::cerr << "--tile must be at least 1\n";
+        return false;
+    }
+    if (!checkRange("--width", sceneOptions.width, 1, MAX_IMAGE_SIZE) ||
+        !checkRange("--height", sceneOptions.height, 1, MAX_IMAGE_SIZE) ||
+        !checkRange("--threads", options.threads, 0, MAX_THREADS) ||
+        !checkRange("--batch", options.batch, 1, std::numeric_limits<int>::max()) ||
+        !checkRange("--instances", sceneOptions.instances, 0, MAX_INSTANCES) ||
+        !checkRange("--workers", options.workers, 0, MAX_THREADS)) {
+        return false;
+    }
+    // 写断点的线程以此为等待时长，不大于 0 时会空转
+    if (!(options.checkpointInterval > 0)) {
+        std::cerr << "--checkpoint-interval must be positive\n";
+        return false;
+    }
+    if (options.workers > 0 && !options.checkpoint.empty()) {
+        std::cerr << "--checkpoint and --resume cannot be combined with --workers\n";
+        return false;
+    }
+    if (options.workers > 0) {
+        // 工作进程沿用同样的参数，各自构建相同的场景
+        options.workerArgs = {argv[0]};
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string_view key = argv[i];
+            if (key == "--workers" || key == "--worker") { continue; }
+            options.workerArgs.insert(options.workerArgs.end(), {argv[i], argv[i + 1]});
+        }
+    }
+    return true;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "CornellBox.hpp"
+#include "Renderer.hpp"
+
+// 解析形如 --spp 64 --threads 8 --tile 32 的命令行参数，argv[0] 为程序路径
+auto parseOptions(int argc, const char* const* argv, RenderOptions& options,
+                  SceneOptions& sceneOptions) -> bool;
@@ -12,8 +12,8 @@ struct Ray {
     Vector3f direction;     // 光的方向
     Vector3f direction_inv; // 光的方向坐标的倒数
     double   t;             // 传播时间
-    double   t_min{0.0};
-    double   t_max{std::numeric_limits<double>::max()};
+    float    t_min{0.F};
+    float    t_max{std::numeric_limits<float>::infinity()};
 
     Ray(const Vector3f& ori, const Vector3f& dir, const double _t = 0.0)
         : origin(ori), direction(dir), t(_t) {
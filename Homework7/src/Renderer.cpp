@@ -3,61 +3,480 @@
 //
 
 #include "Renderer.hpp"
+#include "Camera.hpp"
+#include "Checkpoint.hpp"
+#include "Distributed.hpp"
 #include "Scene.hpp"
+#include "TileScheduler.hpp"
+#include "Wavefront.hpp"
 #include "omp.h"
+#include <atomic>
 #include <format>
 #include <fstream>
 #include <string>
-
-inline auto deg2rad(const float& deg) -> float { return deg * M_PI / 180.0; }
+#include <unordered_map>
 
 const float EPSILON = 0.00001;
 
+namespace {
+    // 把物体下标散列为颜色，相邻下标的颜色差别明显，下标 0 也不会是黑色
+    auto idColor(int32_t id) -> Vector3f {
+        auto h = uint32_t(id + 1) * 2654435761U;
+        return {float(h >> 24) / 255.F, float((h >> 16) & 0xFF) / 255.F,
+                float((h >> 8) & 0xFF) / 255.F};
+    }
+} // namespace
+
 // The main render function. This where we iterate over all pixels in the image,
 // generate primary rays and cast these rays into the scene. The content of the
 // framebuffer is saved to a file.
 void Renderer::Render(const Scene& scene) {
-    std::vector<Vector3f> framebuffer(scene.width * scene.height);
-
-    float    scale            = tan(deg2rad(scene.fov * 0.5));
-    float    imageAspectRatio = scene.width / (float)scene.height;
-    Vector3f eye_pos(278, 273, -800);
-    int      m = 0;
+    int nPixels = scene.width * scene.height;
 
     // sample per pixil
-    int spp = 1024;
-    std::cout << "SPP: " << spp << "\n";
+    int spp      = options.spp;
+    int nThreads = options.threads > 0 ? options.threads : omp_get_num_procs();
+    if (options.workerCount > 0) {
+        renderWorker(scene, nThreads);
+        return;
+    }
+    std::cout << "SPP: " << spp << ", threads: " << nThreads;
+    if (options.workers > 0) { std::cout << ", workers: " << options.workers; }
+    std::cout << "\n";
+
+    // 输出文件在开始渲染前创建，逐块渲染时每个块完成后立即写到文件中
+    std::string base   = outputBase();
+    auto        output = ImageWriter::create(options.format, options.transfer());
+    output->open(base + std::string(ImageWriter::extension(options.format)), scene.width,
+                 scene.height);
+
+    std::vector<PixelStats> stats(nPixels);
+    uint64_t                totalSamples = 0;
+    if (options.workers > 0) {
+        // 各工作进程平分处理器
+        std::vector<std::string> args = options.workerArgs;
+        args.insert(args.end(),
+                    {"--threads", std::to_string(std::max(1, nThreads / options.workers))});
+        TileScheduler tiles(scene.width, scene.height, options.tileSize, 1);
+        if (!runWorkers(args, options.workers, tiles, stats)) {
+            std::cerr << "Distributed render failed\n";
+            return;
+        }
+        for (const PixelStats& ps : stats) { totalSamples += ps.n; }
+    } else {
+        if (options.resume) {
+            if (!loadCheckpoint(options.checkpoint, scene.width, scene.height, stats)) {
+                std::cerr << "Cannot resume from " << options.checkpoint << "\n";
+                return;
+            }
+            uint64_t loaded = 0;
+            for (const PixelStats& ps : stats) { loaded += ps.n; }
+            std::cout << "Resumed from " << options.checkpoint << " (average spp: "
+                      << double(loaded) / nPixels << ")\n";
+            // 断点中已完成的块不会再被渲染，先把它们写出
+            std::vector<Vector3f> restored(nPixels);
+            for (int i = 0; i < nPixels; ++i) { restored[i] = stats[i].mean; }
+            output->write(restored);
+        }
+        std::unique_ptr<Checkpointer> checkpoint;
+        if (!options.checkpoint.empty()) {
+            checkpoint = std::make_unique<Checkpointer>(options.checkpoint, scene.width,
+                                                        scene.height, stats,
+                                                        options.checkpointInterval);
+        }
+        std::vector<uint8_t> owned(nPixels, 1);
+        totalSamples = renderPasses(scene, stats, owned, nThreads, output.get(), checkpoint.get());
+        // 写出最后一份断点，之后可以用更高的 spp 继续渲染
+        checkpoint.reset();
+    }
+    if (options.cancelled()) {
+        std::cout << "\nRender cancelled\n";
+        return;
+    }
+
+    UpdateProgress(1.F);
+    std::cout << "\nSamples traced: " << totalSamples
+              << " (average spp: " << double(totalSamples) / nPixels << ")\n";
+
+    std::vector<Vector3f> framebuffer(nPixels);
+    for (int i = 0; i < nPixels; ++i) { framebuffer[i] = stats[i].mean; }
+
+    // 波前模式与多进程渲染不按块推进，整幅图像最后一次写出
+    if (options.wavefront > 0 || options.workers > 0) { output->write(framebuffer); }
+    output->close();
+    if (!options.reference.empty()) { compareWithReference(framebuffer, scene.width, {}); }
+
+    // 降噪与 AOV 共用相机光线首个交点处的信息
+    GBuffer gbuffer;
+    if (options.denoise > 0 || options.aovs != 0) { gbuffer = renderGBuffer(scene, nThreads); }
+    if (options.aovs != 0) { writeAOVs(scene, gbuffer, stats); }
+
+    if (options.denoise > 0) {
+        auto               denoiseStart = Clock::now();
+        std::vector<float> variance(nPixels);
+        for (int i = 0; i < nPixels; ++i) { variance[i] = stats[i].meanVariance(); }
+
+        DenoiseOptions denoiseOptions;
+        denoiseOptions.iterations = options.denoise;
+        Denoiser(scene.width, scene.height, nThreads, denoiseOptions)
+            .denoise(framebuffer, std::move(variance), gbuffer);
+        std::cout << "Denoised in "
+                  << std::chrono::duration<double, std::milli>(Clock::now() - denoiseStart).count()
+                  << " ms\n";
+        writeImage(base + "_denoised", framebuffer, scene.width, options.transfer());
+        if (!options.reference.empty()) {
+            compareWithReference(framebuffer, scene.width, "denoised");
+        }
+    }
+}
+
+auto Renderer::renderPasses(const Scene& scene, std::vector<PixelStats>& stats,
+                            const std::vector<uint8_t>& owned, int nThreads, ImageWriter* output,
+                            Checkpointer* checkpoint) const -> uint64_t {
+    int spp = options.spp;
+    // 非自适应模式下一轮就采满 spp 个样本
+    int batch = spp;
+    if (options.adaptive()) { batch = std::min(std::max(options.batch, 2), std::max(spp, 2)); }
+    auto deadline = Clock::time_point::max();
+    if (options.timeBudget > 0) {
+        deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                      std::chrono::duration<float>(options.timeBudget));
+    }
+
+    // 从断点继续时已经采满的像素不再采样
+    std::vector<uint8_t> active(owned.size());
+    for (size_t i = 0; i < owned.size(); ++i) {
+        active[i] = owned[i] != 0 && stats[i].n < spp ? 1 : 0;
+    }
+    uint64_t totalSamples = 0;
+    for (int pass = 1;; ++pass) {
+        totalSamples +=
+            options.wavefront > 0
+                ? renderPassWavefront(scene, stats, active, batch, nThreads, deadline, checkpoint)
+                : renderPass(scene, stats, active, batch, nThreads, deadline, output, checkpoint);
+        if (Clock::now() >= deadline || options.cancelled()) { break; }
+
+        int nActive = selectActive(stats, owned, active);
+        if (nActive == 0) { break; }
+        if (options.adaptive()) {
+            std::cout << "\nPass " << pass << ": " << nActive << " pixels still noisy\n";
+        }
+    }
+    return totalSamples;
+}
+
+void Renderer::renderWorker(const Scene& scene, int nThreads) const {
+    TileScheduler        tiles(scene.width, scene.height, options.tileSize, 1);
+    std::vector<uint8_t> owned(size_t(scene.width) * scene.height, 0);
+    for (int t = 0; t < tiles.tileCount(); ++t) {
+        if (!ownsTile(t, options.workerIndex, options.workerCount)) { continue; }
+        Tile tile = tiles.tile(t);
+        for (int j = tile.y0; j < tile.y1; ++j) {
+            std::fill_n(&owned[j * scene.width + tile.x0], tile.width(), 1);
+        }
+    }
+
+    std::vector<PixelStats> stats(owned.size());
+    renderPasses(scene, stats, owned, nThreads, nullptr, nullptr);
+    if (!writeWorkerResult(workerResultStream(), tiles, options.workerIndex, options.workerCount,
+                           stats)) {
+        std::cerr << "Worker " << options.workerIndex << " cannot send its result\n";
+    }
+}
+
+auto Renderer::renderGBuffer(const Scene& scene, int nThreads) const -> GBuffer {
+    Camera  camera(scene);
+    int     nPixels = scene.width * scene.height;
+    GBuffer gbuffer;
+    gbuffer.albedo.assign(nPixels, Vector3f(1.0F));
+    gbuffer.normal.assign(nPixels, Vector3f(0.0F));
+    gbuffer.depth.assign(nPixels, std::numeric_limits<float>::infinity());
+    gbuffer.objectId.assign(nPixels, -1);
+
+    std::unordered_map<const Object*, int32_t> ids;
+    for (size_t i = 0; i < scene.objects.size(); ++i) { ids[scene.objects[i]] = int32_t(i); }
 
-// omp for 语句中的索引变量必须是有符号的整型
-#pragma omp parallel for num_threads(omp_get_num_procs() - 4)
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 4)
     for (int j = 0; j < scene.height; ++j) {
         for (int i = 0; i < scene.width; ++i) {
-            // generate primary ray direction
-            float x = (2 * (i + 0.5) / (float)scene.width - 1) * imageAspectRatio * scale;
-            float y = (1 - 2 * (j + 0.5) / (float)scene.height) * scale;
+            HitRecord    hit;
+            Intersection x = scene.intersect(camera.generateRay(i, j), hit);
+            if (!x.happened) { continue; }
+            int pixel             = j * scene.width + i;
+            gbuffer.albedo[pixel] = x.m->albedo();
+            gbuffer.normal[pixel] = x.normal.normalized();
+            gbuffer.depth[pixel]  = x.distance;
+            auto id               = ids.find(hit.root);
+            if (id != ids.end()) { gbuffer.objectId[pixel] = id->second; }
+        }
+    }
+    return gbuffer;
+}
 
-            Vector3f dir = normalize(Vector3f(-x, y, 1));
-            for (int k = 0; k < spp; k++) {
-                framebuffer[j * scene.width + i] += scene.castRay(Ray(eye_pos, dir), 0) / spp;
+void Renderer::writeAOVs(const Scene& scene, const GBuffer& gbuffer,
+                         const std::vector<PixelStats>& stats) const {
+    int nPixels = scene.width * scene.height;
+
+    // 深度与样本数按图像中的范围归一化
+    float zMin = std::numeric_limits<float>::infinity();
+    float zMax = 0;
+    int   nMax = 1;
+    for (int i = 0; i < nPixels; ++i) {
+        if (std::isfinite(gbuffer.depth[i])) {
+            zMin = std::min(zMin, gbuffer.depth[i]);
+            zMax = std::max(zMax, gbuffer.depth[i]);
+        }
+        nMax = std::max(nMax, stats[i].n);
+    }
+
+    // 浮点格式直接输出原始数据，8 位格式输出可视化的结果
+    bool                  visualize = options.format == ImageFormat::PPM;
+    std::vector<Vector3f> image(nPixels);
+    for (int a = 0; a < int(AOV::COUNT); ++a) {
+        auto aov = AOV(a);
+        if (!options.hasAOV(aov)) { continue; }
+        for (int i = 0; i < nPixels; ++i) {
+            Vector3f& c = image[i];
+            if (!visualize) {
+                switch (aov) {
+                    case AOV::NORMAL: c = gbuffer.normal[i]; break;
+                    case AOV::ALBEDO: c = gbuffer.albedo[i]; break;
+                    case AOV::DEPTH: c = Vector3f(gbuffer.depth[i]); break;
+                    case AOV::OBJECT_ID: c = Vector3f(float(gbuffer.objectId[i])); break;
+                    case AOV::SAMPLES: c = Vector3f(float(stats[i].n)); break;
+                    case AOV::COUNT: break;
+                }
+                continue;
+            }
+
+            // 未命中的像素输出黑色
+            bool hit = std::isfinite(gbuffer.depth[i]);
+            c        = Vector3f(0.0F);
+            switch (aov) {
+                case AOV::NORMAL: {
+                    if (hit) { c = gbuffer.normal[i] * 0.5F + Vector3f(0.5F); }
+                    break;
+                }
+                case AOV::ALBEDO: {
+                    if (hit) { c = gbuffer.albedo[i]; }
+                    break;
+                }
+                case AOV::DEPTH: {
+                    // 近处亮，远处暗
+                    if (hit) {
+                        c = Vector3f(1 - (gbuffer.depth[i] - zMin) / (zMax - zMin + EPSILON));
+                    }
+                    break;
+                }
+                case AOV::OBJECT_ID: {
+                    if (gbuffer.objectId[i] >= 0) { c = idColor(gbuffer.objectId[i]); }
+                    break;
+                }
+                case AOV::SAMPLES: {
+                    c = Vector3f(float(stats[i].n) / float(nMax));
+                    break;
+                }
+                case AOV::COUNT: break;
             }
         }
-#pragma omp critical
-        UpdateProgress(float(++m) / scene.height);
+        std::string base = outputBase() + "_" + AOV_NAMES[a];
+        writeImage(base, image, scene.width, Transfer::LINEAR);
+        std::cout << "AOV " << AOV_NAMES[a] << " written to " << base
+                  << ImageWriter::extension(options.format) << "\n";
     }
+}
 
-    UpdateProgress(1.F);
+auto Renderer::outputBase() const -> std::string {
+    return options.output.empty() ? std::format("./out/binary_{}", options.spp) : options.output;
+}
 
-    // save framebuffer to file
-    std::string filename{std::format("./out/binary_{}.ppm", spp)};
-    FILE*       fp{fopen(filename.data(), "wb")};
+void Renderer::writeImage(const std::string& base, const std::vector<Vector3f>& image, int width,
+                          Transfer transfer) const {
+    auto writer = ImageWriter::create(options.format, transfer);
+    if (writer->open(base + std::string(ImageWriter::extension(options.format)), width,
+                     int(image.size()) / width)) {
+        writer->write(image);
+    }
+    writer->close();
+}
+
+void Renderer::compareWithReference(const std::vector<Vector3f>& framebuffer, int width,
+                                    std::string_view label) const {
+    // 在 8 位输出空间中比较
+    ByteEncoder                encode(options.transfer());
+    std::vector<unsigned char> image(framebuffer.size() * 3);
+    for (size_t i = 0; i < framebuffer.size(); ++i) {
+        image[i * 3]     = encode(framebuffer[i].x);
+        image[i * 3 + 1] = encode(framebuffer[i].y);
+        image[i * 3 + 2] = encode(framebuffer[i].z);
+    }
+    int height = int(framebuffer.size()) / width;
 
-    (void)fprintf(fp, "P6\n%d %d\n255\n", scene.width, scene.height);
-    for (auto i = 0; i < scene.height * scene.width; ++i) {
-        static unsigned char color[3];
-        color[0] = (unsigned char)(255 * std::pow(clamp(0, 1, framebuffer[i].x), 0.6f));
-        color[1] = (unsigned char)(255 * std::pow(clamp(0, 1, framebuffer[i].y), 0.6f));
-        color[2] = (unsigned char)(255 * std::pow(clamp(0, 1, framebuffer[i].z), 0.6f));
-        fwrite(color, 1, 3, fp);
+    FILE* fp       = fopen(options.reference.c_str(), "rb");
+    int   w        = 0;
+    int   h        = 0;
+    int   maxValue = 0;
+    if (fp == nullptr || fscanf(fp, "P6 %d %d %d", &w, &h, &maxValue) != 3 || w != width ||
+        h != height || maxValue != 255) {
+        std::cerr << "Cannot compare with reference " << options.reference << "\n";
+        if (fp != nullptr) { fclose(fp); }
+        return;
     }
+    (void)fgetc(fp); // 头部之后的单个空白
+    std::vector<unsigned char> ref(image.size());
+    size_t                     n = fread(ref.data(), 1, ref.size(), fp);
     fclose(fp);
+    if (n != ref.size()) {
+        std::cerr << "Reference image " << options.reference << " is truncated\n";
+        return;
+    }
+
+    // 在输出的 8 位空间中比较，取值归一化到 [0, 1]
+    double sum = 0;
+    for (size_t i = 0; i < image.size(); ++i) {
+        double d  = (double(image[i]) - double(ref[i])) / 255.0;
+        sum      += d * d;
+    }
+    std::cout << "RMSE vs reference";
+    if (!label.empty()) { std::cout << " (" << label << ")"; }
+    std::cout << ": " << std::sqrt(sum / double(image.size())) << "\n";
+}
+
+auto Renderer::renderPass(const Scene& scene, std::vector<PixelStats>& stats,
+                          const std::vector<uint8_t>& active, int samples, int nThreads,
+                          Clock::time_point deadline, ImageWriter* output,
+                          Checkpointer* checkpoint) const -> uint64_t {
+    Camera camera(scene);
+
+    // 按块调度，线程做完自己的块后窃取其它线程的块，避免负载不均
+    TileScheduler         scheduler(scene.width, scene.height, options.tileSize, nThreads);
+    std::atomic<int>      tilesDone{0};
+    std::atomic<uint64_t> samplesTraced{0};
+    int                   nTiles = scheduler.tileCount();
+
+#pragma omp parallel num_threads(nThreads)
+    {
+        int thread = omp_get_thread_num();
+        // 每个线程在私有的块缓冲中累加，整块完成后再写回，避免伪共享
+        std::vector<PixelStats> tileBuffer(scheduler.tileSize() * scheduler.tileSize());
+        std::vector<Vector3f>   tileColor(tileBuffer.size());
+        uint64_t                traced = 0;
+
+        int tileIndex = 0;
+        while (Clock::now() < deadline && !options.cancelled() &&
+               scheduler.next(thread, tileIndex)) {
+            Tile tile = scheduler.tile(tileIndex);
+            for (int j = tile.y0; j < tile.y1; ++j) {
+                for (int i = tile.x0; i < tile.x1; ++i) {
+                    int         pixel = j * scene.width + i;
+                    PixelStats& ps    = tileBuffer[(j - tile.y0) * tile.width() + (i - tile.x0)];
+                    ps                = stats[pixel];
+                    if (active[pixel] == 0) { continue; }
+
+                    Ray ray   = camera.generateRay(i, j);
+                    int count = std::min(samples, options.spp - ps.n);
+                    for (int k = 0; k < count; k++) {
+                        // 每个样本使用独立的随机数流，结果与线程数无关
+                        Sampler::current().startPixelSample(pixel, ps.n);
+                        ps.add(scene.castRay(ray, 0));
+                    }
+                    traced += count;
+                }
+            }
+            {
+                std::unique_lock<std::mutex> lock;
+                if (checkpoint != nullptr) { lock = std::unique_lock(checkpoint->mutex()); }
+                for (int j = tile.y0; j < tile.y1; ++j) {
+                    std::copy_n(&tileBuffer[(j - tile.y0) * tile.width()], tile.width(),
+                                &stats[j * scene.width + tile.x0]);
+                }
+            }
+            if (output != nullptr) {
+                for (int k = 0; k < tile.width() * tile.height(); ++k) {
+                    tileColor[k] = tileBuffer[k].mean;
+                }
+                output->writeTile(tile, tileColor.data(), tile.width());
+            }
+
+            int done = ++tilesDone;
+            if (thread == 0) { UpdateProgress(float(done) / nTiles); }
+        }
+        samplesTraced += traced;
+    }
+    return samplesTraced;
+}
+
+auto Renderer::renderPassWavefront(const Scene& scene, std::vector<PixelStats>& stats,
+                                   const std::vector<uint8_t>& active, int samples, int nThreads,
+                                   Clock::time_point deadline, Checkpointer* checkpoint) const
+    -> uint64_t {
+    Camera              camera(scene);
+    WavefrontIntegrator integrator(scene, nThreads);
+
+    std::vector<int> pixels;
+    for (int i = 0; i < int(active.size()); ++i) {
+        if (active[i] != 0) { pixels.push_back(i); }
+    }
+
+    // 每批包含若干个像素的全部样本，按像素、样本顺序累加，与深度优先模式结果相同
+    int                  pixelsPerBatch = std::max(1, options.wavefront / samples);
+    std::vector<Ray>     rays;
+    std::vector<Sampler> samplers;
+    uint64_t             traced = 0;
+    for (size_t first = 0;
+         first < pixels.size() && Clock::now() < deadline && !options.cancelled();
+         first += pixelsPerBatch) {
+        size_t last = std::min(pixels.size(), first + pixelsPerBatch);
+        rays.clear();
+        samplers.clear();
+        for (size_t p = first; p < last; ++p) {
+            int pixel = pixels[p];
+            Ray ray   = camera.generateRay(pixel % scene.width, pixel / scene.width);
+            int count = std::min(samples, options.spp - stats[pixel].n);
+            for (int k = 0; k < count; ++k) {
+                rays.push_back(ray);
+                samplers.emplace_back(pixel, stats[pixel].n + k);
+            }
+        }
+
+        const std::vector<Vector3f>& radiance = integrator.trace(rays, samplers);
+        {
+            std::unique_lock<std::mutex> lock;
+            if (checkpoint != nullptr) { lock = std::unique_lock(checkpoint->mutex()); }
+            // 样本按像素顺序排列，与上面生成时一致
+            size_t k = 0;
+            for (size_t p = first; p < last; ++p) {
+                PixelStats& ps    = stats[pixels[p]];
+                int         count = std::min(samples, options.spp - ps.n);
+                for (int i = 0; i < count; ++i) { ps.add(radiance[k++]); }
+            }
+        }
+        traced += rays.size();
+        UpdateProgress(float(last) / float(pixels.size()));
+    }
+    return traced;
+}
+
+auto Renderer::selectActive(const std::vector<PixelStats>& stats,
+                            const std::vector<uint8_t>& owned, std::vector<uint8_t>& active) const
+    -> int {
+    std::vector<float> errors;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const PixelStats& ps = stats[i];
+        // 不归本进程渲染、达到上限，或者误差已经低于阈值的像素不再采样
+        bool done = owned[i] == 0 || ps.n >= options.spp ||
+                    (options.noiseThreshold > 0 && ps.relativeError() <= options.noiseThreshold);
+        active[i] = done ? 0 : 1;
+        if (!done) { errors.push_back(ps.relativeError()); }
+    }
+
+    // 有时间预算时，把剩余时间留给误差最大的那一半像素
+    if (options.timeBudget > 0 && errors.size() > 1) {
+        auto median = errors.begin() + errors.size() / 2;
+        std::nth_element(errors.begin(), median, errors.end());
+        for (size_t i = 0; i < stats.size(); ++i) {
+            if (active[i] != 0 && stats[i].relativeError() < *median) { active[i] = 0; }
+        }
+    }
+    return int(std::count(active.begin(), active.end(), 1));
 }
@@ -1,7 +1,17 @@
 //
 // Created by goksu on 2/25/20.
 //
+#include "Denoiser.hpp"
+#include "ImageWriter.hpp"
 #include "Scene.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Checkpointer;
 
 #pragma once
 struct hit_payload {
@@ -11,9 +21,134 @@ struct hit_payload {
     Object*  hit_obj{};
 };
 
+// 渲染参数
+struct RenderOptions {
+    int spp      = 1024; // sample per pixel，自适应采样时为每个像素的上限
+    int threads  = 0;    // 渲染线程数，0 表示使用全部处理器
+    int tileSize = 16;   // 调度块的边长（像素）
+    int maxDepth = -1;   // 路径最大弹射次数，-1 表示不限制
+
+    // 波前模式：每批同时追踪的路径数，0 表示使用逐像素的深度优先追踪
+    int wavefront = 0;
+
+    // 自适应采样：像素每轮追加 batch 个样本，相对标准误差低于 noiseThreshold 后停止
+    float noiseThreshold = 0; // 0 表示关闭
+    int   batch          = 16;
+    // 时间预算（秒）：到时停止，期间每轮只给误差最大的一半像素追加样本
+    float timeBudget = 0; // 0 表示关闭
+
+    // 降噪：à-trous 的迭代次数，0 表示关闭。开启时额外输出降噪后的图像
+    int denoise = 0;
+    // 需要额外输出的 AOV，第 i 位对应 AOV(i)
+    uint32_t aovs = 0;
+
+    // 输出格式，8 位格式默认沿用 pow(x, 0.6) 的显示曲线
+    ImageFormat format = ImageFormat::PPM;
+    bool        srgb   = false;
+
+    // 输出文件名（不含扩展名），为空时使用 ./out/binary_<spp>
+    std::string output;
+
+    // 参考图像 (PPM)，非空时输出渲染结果与它的均方根误差，用于比较不同积分器的收敛速度
+    std::string reference;
+
+    // 断点文件，非空时每隔 checkpointInterval 秒写出一次累积结果，渲染结束时再写一次
+    std::string checkpoint;
+    float       checkpointInterval = 60;
+    // 从 checkpoint 继续渲染，已有的样本数不小于 spp 的像素不再采样
+    bool resume = false;
+
+    // 多进程渲染：启动 workers 个工作进程分担各块，0 表示在本进程内渲染
+    int workers = 0;
+    // 启动工作进程的程序路径与参数，由 parseOptions 根据自身的命令行生成
+    std::vector<std::string> workerArgs;
+    // 工作进程只渲染 workerCount 份块中的第 workerIndex 份，workerCount 为 0 表示不是工作进程
+    int workerIndex = 0;
+    int workerCount = 0;
+
+    // 非空且被置位时尽快停止渲染，不再输出任何结果。由其它线程置位
+    const std::atomic<bool>* cancel = nullptr;
+
+    auto adaptive() const -> bool { return noiseThreshold > 0 || timeBudget > 0; }
+    auto hasAOV(AOV aov) const -> bool { return ((aovs >> int(aov)) & 1U) != 0; }
+    auto transfer() const -> Transfer { return srgb ? Transfer::SRGB : Transfer::GAMMA; }
+    auto cancelled() const -> bool {
+        return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+    }
+};
+
+// 单个像素的在线统计（Welford 算法），方差按亮度计算
+struct PixelStats {
+    Vector3f mean;
+    float    m2{};
+    int      n{};
+
+    static auto luminance(const Vector3f& c) -> float {
+        return 0.2126F * c.x + 0.7152F * c.y + 0.0722F * c.z;
+    }
+
+    void add(const Vector3f& L) {
+        float delta  = luminance(L) - luminance(mean);
+        mean        += (L - mean) / float(++n);
+        m2          += delta * (luminance(L) - luminance(mean));
+    }
+
+    // 均值的相对标准误差，暗部以 0.01 为下限避免分母过小
+    auto relativeError() const -> float {
+        if (n < 2) { return std::numeric_limits<float>::infinity(); }
+        float variance = m2 / float(n - 1);
+        return std::sqrt(variance / float(n)) / std::max(luminance(mean), 0.01F);
+    }
+
+    // 均值的亮度方差
+    auto meanVariance() const -> float {
+        if (n < 2) { return std::numeric_limits<float>::infinity(); }
+        return m2 / float(n - 1) / float(n);
+    }
+};
+
 class Renderer {
   public:
     void Render(const Scene& scene);
 
+    RenderOptions options;
+
   private:
+    using Clock = std::chrono::steady_clock;
+
+    // 反复给 owned 中的像素追加样本，直到采满 spp、误差低于阈值或用完时间预算，
+    // 返回追加的样本数
+    auto renderPasses(const Scene& scene, std::vector<PixelStats>& stats,
+                      const std::vector<uint8_t>& owned, int nThreads, ImageWriter* output,
+                      Checkpointer* checkpoint) const -> uint64_t;
+    // 工作进程：渲染分到的块，把结果写回协调进程
+    void renderWorker(const Scene& scene, int nThreads) const;
+    // 给 active 中标记的像素各追加 samples 个样本（总数不超过 spp），超过 deadline 后
+    // 不再领取新块，返回实际追加的样本数。output 非空时每个块完成后立即写出；
+    // checkpoint 非空时写回 stats 前先持有它的锁
+    auto renderPass(const Scene& scene, std::vector<PixelStats>& stats,
+                    const std::vector<uint8_t>& active, int samples, int nThreads,
+                    Clock::time_point deadline, ImageWriter* output = nullptr,
+                    Checkpointer* checkpoint = nullptr) const -> uint64_t;
+    // 与 renderPass 相同，但以波前方式成批追踪路径
+    auto renderPassWavefront(const Scene& scene, std::vector<PixelStats>& stats,
+                             const std::vector<uint8_t>& active, int samples, int nThreads,
+                             Clock::time_point deadline,
+                             Checkpointer* checkpoint = nullptr) const -> uint64_t;
+    // 对每个像素的相机光线求交一次，记录首个交点的信息
+    auto renderGBuffer(const Scene& scene, int nThreads) const -> GBuffer;
+    // 把选中的 AOV 可视化后各自输出为一幅图像
+    void writeAOVs(const Scene& scene, const GBuffer& gbuffer,
+                   const std::vector<PixelStats>& stats) const;
+    // 输出文件名（不含扩展名），AOV 与降噪结果在其后加上后缀
+    auto outputBase() const -> std::string;
+    // 按输出格式写出整幅图像，base 为不含扩展名的文件名
+    void writeImage(const std::string& base, const std::vector<Vector3f>& image, int width,
+                    Transfer transfer) const;
+    // 量化为 8 位后输出与参考图像的均方根误差，label 用于区分同一次渲染输出的多幅图像
+    void compareWithReference(const std::vector<Vector3f>& framebuffer, int width,
+                              std::string_view label = {}) const;
+    // 根据统计结果从 owned 中选出下一轮需要继续采样的像素，返回其数量
+    auto selectActive(const std::vector<PixelStats>& stats, const std::vector<uint8_t>& owned,
+                      std::vector<uint8_t>& active) const -> int;
 };
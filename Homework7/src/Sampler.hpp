@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// 基于计数器的随机数流
+//
+// 每个样本的随机数只由 (像素, 样本序号, 维度) 决定：
+// 把 (像素, 样本序号) 散列成 key，第 d 次取数时把 key + d * 增量 送入 PCG 的
+// RXS-M-XS 输出置换。不存在线程间共享的状态，因此无锁，
+// 并且渲染结果与线程数、调度顺序无关。
+class Sampler {
+  public:
+    Sampler() = default;
+    Sampler(uint32_t pixel, uint32_t sampleIndex, uint64_t seed = 0) {
+        startPixelSample(pixel, sampleIndex, seed);
+    }
+
+    // 切换到像素 pixel 的第 sampleIndex 个样本，维度从 0 开始
+    void startPixelSample(uint32_t pixel, uint32_t sampleIndex, uint64_t seed = 0) {
+        key_       = permute((uint64_t(pixel) << 32 | sampleIndex) ^ permute(seed));
+        dimension_ = 0;
+    }
+
+    // 返回 [0, 1) 内的均匀分布随机数
+    auto get1D() -> float {
+        uint64_t bits = permute(key_ + PCG_INCREMENT * ++dimension_);
+        // 取高 24 位，保证结果严格小于 1
+        return float(bits >> 40) * 0x1p-24F;
+    }
+
+    auto dimension() const -> uint32_t { return dimension_; }
+
+    // 当前线程正在使用的随机数流
+    static auto current() -> Sampler& {
+        thread_local Sampler s_sampler;
+        return s_sampler;
+    }
+
+  private:
+    static constexpr uint64_t PCG_MULTIPLIER = 6364136223846793005ULL;
+    static constexpr uint64_t PCG_INCREMENT  = 1442695040888963407ULL;
+
+    // PCG RXS-M-XS 64 位输出置换（双射）
+    static auto permute(uint64_t state) -> uint64_t {
+        state         = state * PCG_MULTIPLIER + PCG_INCREMENT;
+        uint64_t word = ((state >> ((state >> 59U) + 5U)) ^ state) * 12605985483714917081ULL;
+        return (word >> 43U) ^ word;
+    }
+
+    uint64_t key_{0};
+    uint32_t dimension_{0};
+};
@@ -4,35 +4,90 @@
 
 #include "Scene.hpp"
 
-void Scene::buildBVH() {
+namespace {
+    auto luminance(const Vector3f& c) -> float {
+        return 0.2126F * c.x + 0.7152F * c.y + 0.0722F * c.z;
+    }
+
+    // 幂启发式，指数为 2
+    auto powerHeuristic(float pdfA, float pdfB) -> float {
+        float a = pdfA * pdfA;
+        float b = pdfB * pdfB;
+        return a + b > 0 ? a / (a + b) : 0.F;
+    }
+} // namespace
+
+// 只构建顶层 BVH：网格的底层 BVH 已在 MeshTriangle 构造时建好，实例移动后重新调用即可。
+// 光源分布随之一起重建
+void Scene::buildBVH(BVHAccel::SplitMethod splitMethod, SimdLevel simd) {
     printf(" - Generating BVH...\n\n");
-    this->bvh = new BVHAccel(objects, 1, BVHAccel::SplitMethod::NAIVE);
+    this->bvh = std::make_unique<BVHAccel>(objects, 1, splitMethod, 12, simd);
+    buildLightTable();
 }
 
 auto Scene::intersect(const Ray& ray) const -> Intersection { return this->bvh->Intersect(ray); }
 
-/**
- * 该函数根据发光对象的面积对场景中的光源进行采样
- *
- * @param pos 表示光源上的采样位置
- * @param pdf 表示对场景中的光源进行采样的概率密度
- */
-void Scene::sampleLight(Intersection& pos, float& pdf) const {
-    float emit_area_sum = 0;
+auto Scene::intersect(const Ray& ray, HitRecord& hit) const -> Intersection {
+    return this->bvh->Intersect(ray, hit);
+}
+
+auto Scene::intersectP(const Ray& ray) const -> bool { return this->bvh->IntersectP(ray); }
+
+void Scene::buildLightTable() {
+    emissiveTriangles.clear();
+    emissiveObjects.clear();
     for (auto* object : objects) {
-        if (object->hasEmit()) { emit_area_sum += object->getArea(); }
+        if (!object->hasEmit()) { continue; }
+        size_t n = emissiveTriangles.size();
+        object->getEmissiveTriangles(emissiveTriangles);
+        if (emissiveTriangles.size() == n) { emissiveObjects.push_back(object); }
     }
-    float p       = get_random_float() * emit_area_sum;
-    emit_area_sum = 0;
-    for (auto* object : objects) {
-        if (object->hasEmit()) {
-            emit_area_sum += object->getArea();
-            if (p <= emit_area_sum) {
-                object->Sample(pos, pdf);
-                break;
-            }
-        }
+
+    // 权重为面积乘以发光强度的亮度
+    std::vector<float> weights;
+    weights.reserve(emissiveTriangles.size() + emissiveObjects.size());
+    for (const auto& tri : emissiveTriangles) {
+        weights.push_back(tri.area * luminance(tri.emission));
+    }
+    for (auto* object : emissiveObjects) {
+        Intersection pos;
+        float        pdf = 0;
+        object->Sample(pos, pdf);
+        weights.push_back(object->getArea() * luminance(pos.emit));
     }
+    lightTable = AliasTable(weights);
+    lightPower = 0;
+    for (float w : weights) { lightPower += w; }
+}
+
+// 发光物体上均匀采样，被选中的概率与面积乘亮度成正比，
+// 因此面积测度下的密度只与该点的发光亮度有关
+auto Scene::lightPdf(const Intersection& pos) const -> float {
+    return lightPower > 0 ? luminance(pos.m->getEmission()) / lightPower : 0.F;
+}
+
+void Scene::sampleLight(Intersection& pos, float& pdf) const {
+    if (lightTable.empty()) {
+        pdf = 0;
+        return;
+    }
+    float pmf = 0;
+    int   i   = lightTable.sample(get_random_float(), pmf);
+    if (i >= int(emissiveTriangles.size())) {
+        Object* object = emissiveObjects[i - emissiveTriangles.size()];
+        object->Sample(pos, pdf);
+        pdf *= pmf;
+        return;
+    }
+
+    // 在三角形上均匀采样
+    const EmissiveTriangle& tri = emissiveTriangles[i];
+    float                   x   = std::sqrt(get_random_float());
+    float                   y   = get_random_float();
+    pos.coords                  = tri.v0 + tri.e1 * (x * (1.0F - y)) + tri.e2 * (x * y);
+    pos.normal                  = tri.normal;
+    pos.emit                    = tri.emission;
+    pdf                         = pmf / tri.area;
 }
 
 auto Scene::trace(const Ray& ray, const std::vector<Object*>& objects, float& tNear,
@@ -52,63 +107,124 @@ auto Scene::trace(const Ray& ray, const std::vector<Object*>& objects, float& tN
     return (*hitObject != nullptr);
 }
 
+// 在交点 x 处对光源采样一次，返回不考虑遮挡时的直接光照，shadowRay 为对应的阴影光线
+// 光源背对交点或交点背对光源时返回 0
+auto Scene::sampleDirect(const Intersection& x, const Vector3f& wo, Ray& shadowRay,
+                         bool bsdfSampled) const -> Vector3f {
+    Vector3f x_c = x.coords;              // 交点坐标
+    Vector3f x_n = x.normal.normalized(); // 交点法向量
+
+    // 按面积与功率对光源采样 (pdf_light = pmf / A)
+    Intersection x_l;
+    float        x_l_pdf = NAN;
+    sampleLight(x_l, x_l_pdf);
+    if (!(x_l_pdf > 0)) { return {0.0F}; }
+
+    // 从 x_c 向光源点发射一条阴影光线，只需判断两点之间是否有遮挡
+    Vector3f x2l     = x_l.coords - x_c;
+    float    dist2   = dotProduct(x2l, x2l);
+    float    dist    = std::sqrt(dist2);
+    Vector3f dir_x2l = x2l / dist;
+    shadowRay        = Ray(x_c + EPSILON * x_n, dir_x2l);
+    // 略微缩短，避免与光源自身相交
+    shadowRay.t_max = dist * (1.F - 1e-3F);
+
+    float cos_theta   = dotProduct(dir_x2l, x_n);
+    float cos_theta_l = dotProduct(-dir_x2l, x_l.normal);
+    if (cos_theta <= 0 || cos_theta_l <= 0) { return {0.0F}; }
+
+    Vector3f light_int = x_l.emit;                    // 光强
+    Vector3f fr        = x.m->eval(wo, dir_x2l, x_n); // 材质 BRDF
+    Vector3f L_dir     = light_int * fr * cos_theta * cos_theta_l / (dist2 * x_l_pdf);
+    if (!mis || !bsdfSampled) { return L_dir; }
+
+    // 换算到立体角测度后与 BSDF 采样的密度比较
+    float pdf_light = x_l_pdf * dist2 / cos_theta_l;
+    float pdf_bsdf  = x.m->pdf(wo, dir_x2l, x_n);
+    return L_dir * powerHeuristic(pdf_light, pdf_bsdf);
+}
+
+// 俄罗斯轮盘赌后根据 x 的材质随机选取下一段方向 wi，
+// weight 为该段对路径吞吐量的乘子 f * cos / (pdf * P_RR)，路径终止时返回 false
+auto Scene::sampleBounce(const Intersection& x, const Vector3f& wo, Vector3f& wi, Vector3f& weight,
+                         float& pdf) const -> bool {
+    if (get_random_float() > RussianRoulette) { return false; }
+
+    Vector3f x_n = x.normal.normalized();
+    wi           = x.m->sample(wo, x_n).normalized();
+
+    pdf = x.m->pdf(wo, wi, x_n);
+    // pdf 接近于 0 时，除以它计算得到的颜色会偏向极限值，也就是白色
+    if (pdf <= EPSILON) { return false; }
+
+    weight = x.m->eval(wo, wi, x_n) * dotProduct(wi, x_n) / (pdf * RussianRoulette);
+    return true;
+}
+
+auto Scene::emittedMIS(const Vector3f& origin, const Vector3f& wi, float bsdfPdf,
+                       const Intersection& light) const -> Vector3f {
+    // 只使用光源采样时，这部分贡献已经在直接光照中计算过
+    if (!mis) { return {0.0F}; }
+    float cos_theta_l = dotProduct(-wi, light.normal);
+    if (cos_theta_l <= 0) { return {0.0F}; }
+
+    Vector3f d         = light.coords - origin;
+    float    pdf_light = lightPdf(light) * dotProduct(d, d) / cos_theta_l;
+    return light.m->getEmission() * powerHeuristic(bsdfPdf, pdf_light);
+}
+
 // Implementation of Path Tracing
+//
+// 迭代形式：沿路径逐次弹射，用 beta 记录路径吞吐量 (f * cos / pdf 的连乘)，
+// L 累加各顶点的直接光照。下一段光线的交点直接作为下一个顶点，不再重复求交。
 auto Scene::castRay(const Ray& ray, int depth) const -> Vector3f {
     // DONE Implement Path Tracing Algorithm here
 
-    Vector3f L_dir(0.0);   // 直接光照之和
-    Vector3f L_indir(0.0); // 间接光照之和
+    Vector3f L(0.0);    // 已累积的辐射亮度
+    Vector3f beta(1.0); // 路径吞吐量
 
     // 使用 BVH 结构判断相交得到的交点
     Intersection x = Scene::intersect(ray);
 
     // 没有碰到物体，直接返回
-    if (!x.happened) { return L_dir; }
-
-    Vector3f  x_c = x.coords;              // 交点坐标
-    Vector3f  x_n = x.normal.normalized(); // 交点法向量
-    Material* x_m = x.m;                   // 交点材质
-
-    // 随机对光源进行采样 (pdf_light = 1 / A)
-    Intersection x_l;
-    float        x_l_pdf = NAN;
-    sampleLight(x_l, x_l_pdf);
-
-    // 从 x_c 向光源点发射一条光线
-    Vector3f dir_x2l = (x_l.coords - x_c).normalized();
-    Ray      ray_x2l(x_c + EPSILON * x_n, dir_x2l);
-
-    // 光线 ray_x2l 与场景中物体的交点
-    Intersection hit_h2l = Scene::intersect(ray_x2l);
+    if (!x.happened) { return L; }
+
+    // 自身发光只在相机直接看到时计入，之后的弹射由直接光照负责
+    L += x.m->getEmission();
+
+    Vector3f wo = ray.direction;
+    for (int bounce = depth;; ++bounce) {
+        // 直接光照
+        bool     capped = maxDepth >= 0 && bounce >= maxDepth;
+        Ray      ray_x2l(x.coords, wo);
+        Vector3f L_dir = sampleDirect(x, wo, ray_x2l, !capped);
+        if ((L_dir.x > 0 || L_dir.y > 0 || L_dir.z > 0) && !Scene::intersectP(ray_x2l)) {
+            L += beta * L_dir;
+        }
 
-    // 直接光照
-    // 若有交点且交点为发光材质，则光源点与 hit_pos 之间无遮挡
-    if (hit_h2l.happened && hit_h2l.m->hasEmission()) {
-        Vector3f light_n     = hit_h2l.normal;
-        Vector3f light_int   = hit_h2l.m->m_emission;                  // 光强
-        Vector3f fr          = x_m->eval(ray.direction, dir_x2l, x_n); // 材质 BRDF
-        float    cos_theta   = dotProduct(dir_x2l, x_n);
-        float    cos_theta_l = dotProduct(-dir_x2l, light_n);
+        // 间接光照：达到最大弹射次数或者俄罗斯轮盘赌失败时终止
+        if (capped) { break; }
 
-        L_dir = light_int * fr * cos_theta * cos_theta_l / (hit_h2l.distance * x_l_pdf);
-    }
+        Vector3f wi;
+        Vector3f weight;
+        float    pdf = 0;
+        if (!sampleBounce(x, wo, wi, weight, pdf)) { break; }
 
-    // 间接光照
-    if (get_random_float() <= RussianRoulette) {
-        // 根据 x 材质随机选取一个方向发射光线
-        Vector3f     wi = x_m->sample(ray.direction, x_n).normalized();
-        Ray          ray_x2wi(x_c, wi);
+        Ray          ray_x2wi(x.coords, wi);
         Intersection hit_x2wi = Scene::intersect(ray_x2wi);
+        if (!hit_x2wi.happened) { break; }
 
-        if (hit_x2wi.happened && !hit_x2wi.m->hasEmission()) {
-            float pdf = x_m->pdf(ray.direction, wi, x_n);
-            // pdf 接近于 0 时，除以它计算得到的颜色会偏向极限值，也就是白色
-            if (pdf > EPSILON) {
-                L_indir = castRay(ray_x2wi, depth + 1) * x_m->eval(ray.direction, wi, x_n) *
-                          dotProduct(wi, x_n) / (pdf * RussianRoulette);
-            }
+        beta = beta * weight;
+        // 打到光源：按 MIS 权重计入 BSDF 采样得到的发光，路径到此为止
+        if (hit_x2wi.m->hasEmission()) {
+            L += beta * emittedMIS(x.coords, wi, pdf, hit_x2wi);
+            break;
         }
+
+        wo = wi;
+        x  = hit_x2wi;
     }
-    // 自身发光 + 直接光照 + 间接光照
-    return x_m->getEmission() + L_dir + L_indir;
+
+    // 自身发光 + 各顶点的直接光照
+    return L;
 }
@@ -4,12 +4,14 @@
 
 #pragma once
 
+#include "AliasTable.hpp"
 #include "AreaLight.hpp"
 #include "BVH.hpp"
 #include "Light.hpp"
 #include "Object.hpp"
 #include "Ray.hpp"
 #include "Vector.hpp"
+#include <memory>
 #include <vector>
 
 class Scene {
@@ -18,12 +20,16 @@ class Scene {
     int      width           = 1280;
     int      height          = 960;
     double   fov             = 40;
+    Vector3f eye             = Vector3f(278, 273, -800); // 相机位置
     Vector3f backgroundColor = Vector3f(0.235294, 0.67451, 0.843137);
-    int      maxDepth        = 1;
+    int      maxDepth        = -1; // 最大弹射次数，-1 表示只由俄罗斯轮盘赌终止
     float    RussianRoulette = 0.8;
+    // 直接光照同时使用光源采样与 BSDF 采样，按幂启发式 (power heuristic) 合并；
+    // 关闭时只使用光源采样
+    bool mis = true;
 
     Scene(int w, int h) : width(w), height(h) {}
-    BVHAccel* bvh;
+    std::unique_ptr<BVHAccel> bvh;
 
     void Add(Object* object) { objects.push_back(object); }
     void Add(std::unique_ptr<Light> light) { lights.push_back(std::move(light)); }
@@ -31,9 +37,24 @@ class Scene {
     auto get_objects() const -> const std::vector<Object*>& { return objects; }
     auto get_lights() const -> const std::vector<std::unique_ptr<Light>>& { return lights; }
     auto intersect(const Ray& ray) const -> Intersection;
-    void buildBVH();
+    // 同上，hit.root 为被命中的物体在 objects 中对应的指针
+    auto intersect(const Ray& ray, HitRecord& hit) const -> Intersection;
+    // 光线在 ray.t_max 之前是否被遮挡
+    auto intersectP(const Ray& ray) const -> bool;
+    void buildBVH(BVHAccel::SplitMethod splitMethod, SimdLevel simd);
     auto castRay(const Ray& ray, int depth) const -> Vector3f;
+    // bsdfSampled 表示这个顶点之后还会进行 BSDF 采样，此时光源采样的结果按 MIS 加权
+    auto sampleDirect(const Intersection& x, const Vector3f& wo, Ray& shadowRay,
+                      bool bsdfSampled) const -> Vector3f;
+    auto sampleBounce(const Intersection& x, const Vector3f& wo, Vector3f& wi, Vector3f& weight,
+                      float& pdf) const -> bool;
+    // 从 origin 沿 BSDF 采样方向 wi 打到光源 light 时，按 MIS 权重计入的发光
+    auto emittedMIS(const Vector3f& origin, const Vector3f& wi, float bsdfPdf,
+                    const Intersection& light) const -> Vector3f;
+    // 按面积与功率之积在所有发光图元中采样一点，pdf 为面积测度下的概率密度
     void sampleLight(Intersection& pos, float& pdf) const;
+    // 光源上一点被 sampleLight 采到的概率密度（面积测度）
+    auto lightPdf(const Intersection& pos) const -> float;
     auto trace(const Ray& ray, const std::vector<Object*>& objects, float& tNear, uint32_t& index,
                Object** hitObject) -> bool;
     auto HandleAreaLight(const AreaLight& light, const Vector3f& hitPoint, const Vector3f& N,
@@ -45,6 +66,14 @@ class Scene {
     std::vector<Object*>                objects;
     std::vector<std::unique_ptr<Light>> lights;
 
+    // 光源分布，随 BVH 一起构建。下标小于 emissiveTriangles.size() 的为三角形，
+    // 其余对应 emissiveObjects 中不由三角形组成的发光物体
+    std::vector<EmissiveTriangle> emissiveTriangles;
+    std::vector<Object*>          emissiveObjects;
+    AliasTable                    lightTable;
+    float                         lightPower = 0; // 所有权重之和
+    void                          buildLightTable();
+
     // Compute reflection direction
     auto reflect(const Vector3f& I, const Vector3f& N) const -> Vector3f {
         return I - 2 * dotProduct(I, N) * N;
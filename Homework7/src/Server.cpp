@@ -0,0 +1,310 @@
+#include "Server.hpp"
+#include "Options.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // 平台相关的套接字操作
+#ifdef _WIN32
+    using Socket             = SOCKET;
+    constexpr int SEND_FLAGS = 0;
+    void          closeSocket(Socket s) { closesocket(s); }
+#else
+    using Socket                    = int;
+    constexpr Socket INVALID_SOCKET = -1;
+    constexpr int    SEND_FLAGS     = MSG_NOSIGNAL; // 对方先关闭连接时不要因为 SIGPIPE 退出
+    void             closeSocket(Socket s) { close(s); }
+#endif
+
+    constexpr size_t MAX_LINE = 4096;
+
+    // 读到换行为止，连接关闭或超长时返回 false
+    auto receiveLine(Socket s, std::string& line) -> bool {
+        line.clear();
+        char c = 0;
+        while (recv(s, &c, 1, 0) == 1) {
+            if (c == '\n') { return true; }
+            if (c != '\r') { line.push_back(c); }
+            if (line.size() > MAX_LINE) { return false; }
+        }
+        return false;
+    }
+
+    void sendLine(Socket s, const std::string& line) {
+        std::string data = line + "\n";
+        size_t      sent = 0;
+        while (sent < data.size()) {
+            auto n = send(s, data.data() + sent, int(data.size() - sent), SEND_FLAGS);
+            if (n <= 0) { return; }
+            sent += size_t(n);
+        }
+    }
+
+    auto split(const std::string& line) -> std::vector<std::string> {
+        std::vector<std::string> words;
+        std::istringstream       in(line);
+        for (std::string word; in >> word;) { words.push_back(word); }
+        return words;
+    }
+
+    auto stateName(int state) -> const char* {
+        constexpr const char* NAMES[] = {"queued", "running", "done", "cancelled", "failed"};
+        return NAMES[state];
+    }
+} // namespace
+
+RenderServer::RenderServer(std::string program, const RenderOptions& defaults,
+                           const SceneOptions& sceneDefaults)
+    : program_(std::move(program)), defaults_(defaults), sceneDefaults_(sceneDefaults) {}
+
+auto RenderServer::run(int port) -> bool {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { return false; }
+#endif
+    Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) { return false; }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse),
+               sizeof(reuse));
+    // 只接受本机的连接
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 16) != 0) {
+        std::cerr << "Cannot listen on port " << port << "\n";
+        closeSocket(listener);
+        return false;
+    }
+    std::cout << "Render server listening on 127.0.0.1:" << port << std::endl;
+
+    std::thread renderer([this] { renderLoop(); });
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) { break; }
+        }
+        // 定时醒来检查是否已收到 shutdown
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        timeval timeout{0, 200000};
+        if (select(int(listener + 1), &readable, nullptr, nullptr, &timeout) <= 0) { continue; }
+        Socket client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) { continue; }
+
+        // wait 会一直阻塞到任务结束，每个连接使用单独的线程
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++connections_;
+        }
+        std::thread([this, client] {
+            std::string line;
+            if (receiveLine(client, line)) { sendLine(client, handle(line)); }
+            closeSocket(client);
+            std::lock_guard<std::mutex> lock(mutex_);
+            --connections_;
+            changed_.notify_all();
+        }).detach();
+    }
+    closeSocket(listener);
+
+    renderer.join();
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return connections_ == 0; });
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return true;
+}
+
+auto RenderServer::handle(const std::string& line) -> std::string {
+    std::vector<std::string> words = split(line);
+    if (words.empty()) { return "error empty command"; }
+    const std::string& command = words[0];
+    if (command == "render") { return submit(words); }
+    if (command == "status") { return status(); }
+    if (command == "shutdown") {
+        shutdown();
+        return "bye";
+    }
+    if ((command == "cancel" || command == "wait") && words.size() == 2) {
+        int id = std::atoi(words[1].c_str());
+        return command == "cancel" ? cancel(id) : wait(id);
+    }
+    return "error unknown command " + line;
+}
+
+auto RenderServer::submit(const std::vector<std::string>& args) -> std::string {
+    auto job     = std::make_shared<Job>();
+    job->options = defaults_;
+    job->scene   = sceneDefaults_;
+    // 第一个参数 render 换成程序路径，作为 argv[0] 交给命令行解析
+    std::vector<const char*> argv = {program_.c_str()};
+    std::string              output;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "--priority" && i + 1 < args.size()) {
+            job->priority = std::atoi(args[++i].c_str());
+        } else if (args[i] == "--checkpoint" || args[i] == "--resume" ||
+                   args[i] == "--reference") {
+            // 任务不能读写服务器之外指定的文件
+            return "error " + args[i] + " is not allowed in a job";
+        } else if (args[i] == "--output" && i + 1 < args.size()) {
+            // 输出只能是 ./out 下的文件名
+            const std::string& name = args[++i];
+            if (name.empty() || name[0] == '.' ||
+                name.find_first_of("/\\:") != std::string::npos) {
+                return "error invalid output name " + name;
+            }
+            output = "./out/" + name;
+        } else {
+            argv.push_back(args[i].c_str());
+        }
+    }
+    if (!parseOptions(int(argv.size()), argv.data(), job->options, job->scene)) {
+        return "error invalid options";
+    }
+    // 工作进程会在服务器之外按任务的参数重新运行本程序，任务只能在本进程内渲染
+    if (job->options.workers > 0 || job->options.workerCount > 0) {
+        return "error --workers is not allowed in a job";
+    }
+    if (!output.empty()) { job->options.output = output; }
+    job->options.cancel = &job->cancel;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) { return "error server is shutting down"; }
+    job->id = nextId_++;
+    jobs_.emplace(job->id, job);
+    queue_.emplace(-job->priority, job->id);
+    changed_.notify_all();
+    return std::format("queued {}", job->id);
+}
+
+auto RenderServer::cancel(int id) -> std::string {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto                        it = jobs_.find(id);
+    if (it == jobs_.end()) { return std::format("error unknown job {}", id); }
+    Job& job = *it->second;
+    if (job.state == JobState::QUEUED) {
+        queue_.erase({-job.priority, id});
+        job.state = JobState::CANCELLED;
+        changed_.notify_all();
+    } else if (job.state == JobState::RUNNING) {
+        // 渲染线程在下一个块或下一批之前停下，随后把状态改为 CANCELLED
+        job.cancel = true;
+    } else {
+        return std::format("error job {} already {}", id, stateName(int(job.state)));
+    }
+    return std::format("cancelling {}", id);
+}
+
+auto RenderServer::wait(int id) -> std::string {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto                         it = jobs_.find(id);
+    if (it == jobs_.end()) { return std::format("error unknown job {}", id); }
+    std::shared_ptr<Job> job = it->second;
+    changed_.wait(lock, [&] {
+        return job->state != JobState::QUEUED && job->state != JobState::RUNNING;
+    });
+    if (job->state == JobState::CANCELLED) { return std::format("cancelled {}", id); }
+    if (job->state == JobState::FAILED) { return std::format("failed {}", id); }
+    return std::format("done {} {:.1f}", id, job->milliseconds);
+}
+
+auto RenderServer::status() -> std::string {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string                 reply = std::format("jobs {}", jobs_.size());
+    for (const auto& [id, job] : jobs_) {
+        reply += std::format(" {}:{}:{}", id, stateName(int(job->state)), job->priority);
+    }
+    return reply;
+}
+
+void RenderServer::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    for (const auto& [id, job] : jobs_) {
+        if (job->state == JobState::QUEUED) { job->state = JobState::CANCELLED; }
+        if (job->state == JobState::RUNNING) { job->cancel = true; }
+    }
+    queue_.clear();
+    changed_.notify_all();
+}
+
+void RenderServer::renderLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_) { return; }
+            job = jobs_[queue_.begin()->second];
+            queue_.erase(queue_.begin());
+            job->state = JobState::RUNNING;
+        }
+
+        // 单个任务出错不应结束整个服务器
+        bool failed = false;
+        try {
+            render(*job);
+        } catch (const std::exception& e) {
+            std::cerr << "Job " << job->id << " failed: " << e.what() << std::endl;
+            failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        job->state = failed        ? JobState::FAILED
+                     : job->cancel ? JobState::CANCELLED
+                                   : JobState::DONE;
+        changed_.notify_all();
+    }
+}
+
+void RenderServer::render(Job& job) {
+    using Clock = std::chrono::steady_clock;
+    auto start  = Clock::now();
+
+    std::cout << "\nJob " << job.id << " (priority " << job.priority << ")\n";
+    auto key = job.scene.geometryKey();
+    auto it  = std::find_if(scenes_.begin(), scenes_.end(),
+                            [&](const auto& entry) { return entry.first == key; });
+    if (it != scenes_.end()) {
+        scenes_.splice(scenes_.begin(), scenes_, it);
+        scenes_.front().second->configure(job.scene);
+    } else {
+        // 先释放最久未用的场景，再加载新的
+        while (scenes_.size() >= MAX_CACHED_SCENES) { scenes_.pop_back(); }
+        scenes_.emplace_front(key, std::make_unique<CornellBox>(job.scene));
+        std::cout << "Scene loaded in "
+                  << std::chrono::duration<double, std::milli>(Clock::now() - start).count()
+                  << " ms, " << scenes_.size() << " cached\n";
+    }
+    CornellBox& box    = *scenes_.front().second;
+    box.scene.maxDepth = job.options.maxDepth;
+
+    Renderer renderer;
+    renderer.options = job.options;
+    renderer.Render(box.scene);
+    job.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "Job " << job.id << (job.cancel ? " cancelled" : " finished") << " after "
+              << job.milliseconds << " ms" << std::endl;
+}
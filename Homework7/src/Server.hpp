@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CornellBox.hpp"
+#include "Renderer.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 常驻渲染服务器
+//
+// 在 127.0.0.1 上监听 TCP 端口，每个连接发送一行命令，收到一行回复：
+//   render [--priority P] [选项...]  加入队列，回复 queued <id>。选项与命令行相同
+//   cancel <id>                      取消排队中或正在渲染的任务
+//   wait <id>                        等到任务结束，回复 done <id> <ms>、cancelled <id>
+//                                    或 failed <id>
+//   status                           列出全部任务的状态
+//   shutdown                         取消全部任务并退出
+// 任务不能启动工作进程，也不能指定断点与参考图像等服务器之外的文件，--output 只接受
+// 文件名，结果写到 ./out 下。
+// 任务按优先级从高到低、同优先级按提交顺序逐个渲染，每个任务使用全部线程。
+// 加载好的网格与 BVH 按 SceneOptions::geometryKey() 缓存，几何相同的任务只需
+// 修改分辨率与相机即可开始追踪。缓存只保留最近使用的几个场景。
+class RenderServer {
+  public:
+    // program 为本程序的路径，defaults 与 sceneDefaults 为各任务选项的初始值
+    RenderServer(std::string program, const RenderOptions& defaults,
+                 const SceneOptions& sceneDefaults);
+
+    // 监听 port 直到收到 shutdown，端口无法使用时返回 false
+    auto run(int port) -> bool;
+
+  private:
+    enum class JobState { QUEUED, RUNNING, DONE, CANCELLED, FAILED };
+
+    struct Job {
+        int               id       = 0;
+        int               priority = 0;
+        RenderOptions     options;
+        SceneOptions      scene;
+        JobState          state = JobState::QUEUED;
+        std::atomic<bool> cancel{false};
+        double            milliseconds = 0; // 渲染耗时，包括加载场景
+    };
+
+    // 处理一行命令，返回回复（不含换行）
+    auto handle(const std::string& line) -> std::string;
+    auto submit(const std::vector<std::string>& args) -> std::string;
+    auto cancel(int id) -> std::string;
+    auto wait(int id) -> std::string;
+    auto status() -> std::string;
+    void shutdown();
+    // 渲染线程：依次取出队列中的任务并渲染
+    void renderLoop();
+    void render(Job& job);
+
+    std::string   program_;
+    RenderOptions defaults_;
+    SceneOptions  sceneDefaults_;
+
+    std::mutex                          mutex_;
+    std::condition_variable             changed_; // 任务状态变化、连接关闭或服务器停止
+    std::map<int, std::shared_ptr<Job>> jobs_;
+    std::set<std::pair<int, int>>       queue_; // (-priority, id)，首个元素为下一个任务
+    int                                 nextId_      = 1;
+    int                                 connections_ = 0; // 未关闭的连接数
+    bool                                stop_        = false;
+
+    // 只由渲染线程访问。最近使用的在前，超过 MAX_CACHED_SCENES 个时丢弃最久未用的
+    static constexpr size_t MAX_CACHED_SCENES = 4;
+    std::list<std::pair<SceneOptions::GeometryKey, std::unique_ptr<CornellBox>>> scenes_;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// 图像中的一个矩形块 [x0, x1) x [y0, y1)
+struct Tile {
+    int x0, y0, x1, y1;
+
+    auto width() const -> int { return x1 - x0; }
+    auto height() const -> int { return y1 - y0; }
+};
+
+// 基于工作窃取的块调度器
+//
+// 块按行优先顺序切成 nThreads 段连续区间，每个线程一段，保证空间局部性。
+// 每段区间的 [front, back) 打包在一个 64 位原子量中：
+// 线程从自己区间的前端取块，自己的取完后从其它线程区间的后端窃取，全程无锁。
+class TileScheduler {
+  public:
+    TileScheduler(int width, int height, int tileSize, int nThreads)
+        : width_(width), height_(height), tileSize_(std::max(1, tileSize)),
+          nThreads_(std::max(1, nThreads)), queues_(new Queue[nThreads_]) {
+        tilesX_    = (width_ + tileSize_ - 1) / tileSize_;
+        tilesY_    = (height_ + tileSize_ - 1) / tileSize_;
+        int nTiles = tileCount();
+        for (int t = 0; t < nThreads_; ++t) {
+            uint32_t front = uint64_t(nTiles) * t / nThreads_;
+            uint32_t back  = uint64_t(nTiles) * (t + 1) / nThreads_;
+            queues_[t].range.store(pack(front, back), std::memory_order_relaxed);
+        }
+    }
+
+    auto width() const -> int { return width_; }
+    auto height() const -> int { return height_; }
+    auto tileSize() const -> int { return tileSize_; }
+    auto tileCount() const -> int { return tilesX_ * tilesY_; }
+
+    auto tile(int index) const -> Tile {
+        int x0 = (index % tilesX_) * tileSize_;
+        int y0 = (index / tilesX_) * tileSize_;
+        return {x0, y0, std::min(x0 + tileSize_, width_), std::min(y0 + tileSize_, height_)};
+    }
+
+    // 为线程 thread 取下一个块，所有块都已分出时返回 false
+    auto next(int thread, int& tileIndex) -> bool {
+        thread = thread % nThreads_;
+        if (popFront(queues_[thread], tileIndex)) { return true; }
+        for (int i = 1; i < nThreads_; ++i) {
+            if (popBack(queues_[(thread + i) % nThreads_], tileIndex)) { return true; }
+        }
+        return false;
+    }
+
+  private:
+    // 独占一条缓存行，避免不同线程的队列之间伪共享
+    struct alignas(64) Queue {
+        std::atomic<uint64_t> range{0};
+    };
+
+    static auto pack(uint32_t front, uint32_t back) -> uint64_t {
+        return uint64_t(front) << 32 | back;
+    }
+
+    static auto popFront(Queue& queue, int& tileIndex) -> bool {
+        uint64_t range = queue.range.load(std::memory_order_relaxed);
+        while (true) {
+            auto front = uint32_t(range >> 32);
+            auto back  = uint32_t(range);
+            if (front >= back) { return false; }
+            if (queue.range.compare_exchange_weak(range, pack(front + 1, back))) {
+                tileIndex = int(front);
+                return true;
+            }
+        }
+    }
+
+    static auto popBack(Queue& queue, int& tileIndex) -> bool {
+        uint64_t range = queue.range.load(std::memory_order_relaxed);
+        while (true) {
+            auto front = uint32_t(range >> 32);
+            auto back  = uint32_t(range);
+            if (front >= back) { return false; }
+            if (queue.range.compare_exchange_weak(range, pack(front, back - 1))) {
+                tileIndex = int(back - 1);
+                return true;
+            }
+        }
+    }
+
+    int                      width_, height_, tileSize_, nThreads_;
+    int                      tilesX_, tilesY_;
+    std::unique_ptr<Queue[]> queues_;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Bounds3.hpp"
+#include "Ray.hpp"
+#include "Vector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <utility>
+
+// 行优先的 4x4 矩阵
+struct Matrix4x4 {
+    Matrix4x4() {
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) { m[i][j] = i == j ? 1.F : 0.F; }
+        }
+    }
+
+    friend auto operator*(const Matrix4x4& a, const Matrix4x4& b) -> Matrix4x4 {
+        Matrix4x4 r;
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] +
+                            a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+            }
+        }
+        return r;
+    }
+
+    // 带列主元的高斯-约当消元，矩阵奇异时返回单位矩阵
+    auto Inverse() const -> Matrix4x4 {
+        double a[4][8];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                a[i][j]     = m[i][j];
+                a[i][j + 4] = i == j ? 1.0 : 0.0;
+            }
+        }
+        for (int c = 0; c < 4; ++c) {
+            int pivot = c;
+            for (int r = c + 1; r < 4; ++r) {
+                if (std::fabs(a[r][c]) > std::fabs(a[pivot][c])) { pivot = r; }
+            }
+            if (a[pivot][c] == 0) { return {}; }
+            std::swap(a[c], a[pivot]);
+            double inv = 1.0 / a[c][c];
+            for (double& x : a[c]) { x *= inv; }
+            for (int r = 0; r < 4; ++r) {
+                if (r == c) { continue; }
+                double f = a[r][c];
+                for (int k = 0; k < 8; ++k) { a[r][k] -= f * a[c][k]; }
+            }
+        }
+        Matrix4x4 r;
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) { r.m[i][j] = float(a[i][j + 4]); }
+        }
+        return r;
+    }
+
+    float m[4][4];
+};
+
+// 仿射变换，同时保存矩阵与逆矩阵
+class Transform {
+  public:
+    Transform() = default;
+    explicit Transform(const Matrix4x4& m) : m_(m), mInv_(m.Inverse()) {}
+    Transform(const Matrix4x4& m, const Matrix4x4& mInv) : m_(m), mInv_(mInv) {}
+
+    static auto Translate(const Vector3f& delta) -> Transform {
+        Matrix4x4 m;
+        Matrix4x4 mInv;
+        for (int i = 0; i < 3; ++i) {
+            m.m[i][3]    = delta[i];
+            mInv.m[i][3] = -delta[i];
+        }
+        return {m, mInv};
+    }
+
+    static auto Scale(float x, float y, float z) -> Transform {
+        Matrix4x4 m;
+        Matrix4x4 mInv;
+        float     s[3] = {x, y, z};
+        for (int i = 0; i < 3; ++i) {
+            m.m[i][i]    = s[i];
+            mInv.m[i][i] = 1.F / s[i];
+        }
+        return {m, mInv};
+    }
+
+    // 绕 axis 旋转 theta 度，旋转矩阵的逆为其转置
+    static auto Rotate(float theta, const Vector3f& axis) -> Transform {
+        Vector3f  a    = normalize(axis);
+        float     rad  = theta * std::numbers::pi_v<float> / 180.F;
+        float     sinT = std::sin(rad);
+        float     cosT = std::cos(rad);
+        Matrix4x4 m;
+        m.m[0][0] = a.x * a.x + (1 - a.x * a.x) * cosT;
+        m.m[0][1] = a.x * a.y * (1 - cosT) - a.z * sinT;
+        m.m[0][2] = a.x * a.z * (1 - cosT) + a.y * sinT;
+        m.m[1][0] = a.x * a.y * (1 - cosT) + a.z * sinT;
+        m.m[1][1] = a.y * a.y + (1 - a.y * a.y) * cosT;
+        m.m[1][2] = a.y * a.z * (1 - cosT) - a.x * sinT;
+        m.m[2][0] = a.x * a.z * (1 - cosT) - a.y * sinT;
+        m.m[2][1] = a.y * a.z * (1 - cosT) + a.x * sinT;
+        m.m[2][2] = a.z * a.z + (1 - a.z * a.z) * cosT;
+        Matrix4x4 mInv;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) { mInv.m[i][j] = m.m[j][i]; }
+        }
+        return {m, mInv};
+    }
+
+    auto Inverse() const -> Transform { return {mInv_, m_}; }
+
+    // 先应用 t 再应用 *this
+    auto operator*(const Transform& t) const -> Transform {
+        return {m_ * t.m_, t.mInv_ * mInv_};
+    }
+
+    auto ApplyPoint(const Vector3f& p) const -> Vector3f {
+        const auto& m = m_.m;
+        return {m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]};
+    }
+
+    auto ApplyVector(const Vector3f& v) const -> Vector3f {
+        const auto& m = m_.m;
+        return {m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z};
+    }
+
+    // 法线按逆矩阵的转置变换，结果未归一化
+    auto ApplyNormal(const Vector3f& n) const -> Vector3f {
+        const auto& mi = mInv_.m;
+        return {mi[0][0] * n.x + mi[1][0] * n.y + mi[2][0] * n.z,
+                mi[0][1] * n.x + mi[1][1] * n.y + mi[2][1] * n.z,
+                mi[0][2] * n.x + mi[1][2] * n.y + mi[2][2] * n.z};
+    }
+
+    // 方向不归一化，变换前后同一点对应的参数 t 不变，t_min/t_max 可以直接沿用
+    auto operator()(const Ray& r) const -> Ray {
+        Ray ray(ApplyPoint(r.origin), ApplyVector(r.direction), r.t);
+        ray.t_min = r.t_min;
+        ray.t_max = r.t_max;
+        return ray;
+    }
+
+    // 变换包围盒的 8 个顶点后重新求包围盒
+    auto operator()(const Bounds3& b) const -> Bounds3 {
+        Bounds3 r;
+        for (int c = 0; c < 8; ++c) {
+            Vector3f p((c & 1) != 0 ? b.pMax.x : b.pMin.x, (c & 2) != 0 ? b.pMax.y : b.pMin.y,
+                       (c & 4) != 0 ? b.pMax.z : b.pMin.z);
+            r = Union(r, ApplyPoint(p));
+        }
+        return r;
+    }
+
+  private:
+    Matrix4x4 m_;
+    Matrix4x4 mInv_;
+};
@@ -1,13 +1,18 @@
 #pragma once
 
 #include "BVH.hpp"
+#include "BVHCache.hpp"
 #include "Intersection.hpp"
 #include "Material.hpp"
-#include "OBJ_Loader.hpp"
+#include "MeshFile.hpp"
+#include "ObjParser.hpp"
 #include "Object.hpp"
 #include "Triangle.hpp"
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <filesystem>
+#include <memory>
 
 auto rayTriangleIntersect(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
                           const Vector3f& orig, const Vector3f& dir, float& tnear, float& u,
@@ -74,17 +79,79 @@ class Triangle : public Object {
     auto getArea() -> float { return area; }
     // 返回材质是否自发光
     auto hasEmit() -> bool { return m->hasEmission(); }
+    auto getVertices(std::array<Vector3f, 3>& v) const -> bool override {
+        v = {v0, v1, v2};
+        return true;
+    }
+    auto closestHit(const Ray& ray, HitRecord& hit) -> bool override;
+    auto getIntersection(const Ray& ray, const HitRecord& hit) -> Intersection override;
+    void getEmissiveTriangles(std::vector<EmissiveTriangle>& out) override {
+        if (m->hasEmission()) { out.push_back({v0, e1, e2, normal, m->getEmission(), area}); }
+    }
 };
 
+// 三角形网格。顶点去重后只保存一份，三角形由 vertexIndex 中的三个下标给出，
+// BVH 的叶子中记录三角形的下标，命中后由共享的顶点缓冲得到表面信息
 class MeshTriangle : public Object {
   public:
-    MeshTriangle(const std::string& filename, Material* mt = new Material()) {
-        objl::Loader loader;
-        loader.LoadFile(filename);
+    // simd 与 splitMethod 为 BVH 的构建设置，useCache 为 false 时不读写 BVH 缓存
+    MeshTriangle(const std::string& filename, Material* mt = new Material(),
+                 SimdLevel             simd        = detectSimdLevel(),
+                 BVHAccel::SplitMethod splitMethod = BVHAccel::SplitMethod::SAH,
+                 bool                  useCache    = true) {
         area = 0;
         m    = mt;
-        assert(loader.LoadedMeshes.size() == 1);
-        auto mesh = loader.LoadedMeshes[0];
+        // 叶子大小与 SIMD 宽度一致，一个叶子正好打包成一个三角形块
+        const int   width     = simdWidth(simd);
+        const int   nBuckets  = 12;
+        std::string cacheFile = filename + ".bvh";
+        uint64_t    key       = 0;
+        if (useCache) {
+            key = BVHCache::makeKey(filename, width, splitMethod, nBuckets, width);
+        }
+        BVHCache cache;
+        bool     cached = key != 0 && cache.open(cacheFile, key, width);
+
+        // 命中缓存时不需要解析 OBJ，顶点与索引保存在缓存中。
+        // 否则转换好的二进制网格直接映射，或者解析 OBJ，三者都由索引给出三角形
+        MeshFile                          meshFile;
+        ObjMesh                           objMesh;
+        std::span<const MeshFile::Float3> positions;
+        std::span<const MeshFile::Float2> texCoords;
+        std::span<const uint32_t>         indices;
+        if (cached) {
+            positions = cache.positions();
+            texCoords = cache.texCoords();
+            indices   = cache.indices();
+        } else if (filename.ends_with(".mesh") && meshFile.open(filename)) {
+            positions = meshFile.positions();
+            texCoords = meshFile.texCoords();
+            indices   = meshFile.indices();
+        } else {
+            // 二进制网格无法打开时退回到同名的 OBJ。缓存的键与文件名都来自二进制网格，
+            // 与实际加载的 OBJ 对不上，这时不写缓存
+            std::string objFile = filename;
+            if (filename.ends_with(".mesh")) {
+                fprintf(stderr, "Cannot load mesh %s, using OBJ\n", filename.c_str());
+                objFile = std::filesystem::path(filename).replace_extension(".obj").string();
+                key     = 0;
+            }
+            loadObj(objFile, objMesh);
+            positions = objMesh.positions;
+            texCoords = objMesh.texCoords;
+            indices   = objMesh.indices;
+        }
+
+        vertices.resize(positions.size());
+        stCoordinates.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); ++i) {
+            vertices[i]      = Vector3f(positions[i].x, positions[i].y, positions[i].z);
+            stCoordinates[i] = Vector2f(texCoords[i].x, texCoords[i].y);
+        }
+        vertexIndex.assign(indices.begin(), indices.end());
+        numTriangles = uint32_t(vertexIndex.size() / 3);
+        // 没有面的网格不构建 BVH，也不写缓存，包围盒为空，求交总是未命中
+        if (numTriangles == 0) { return; }
 
         Vector3f min_vert =
             Vector3f{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
@@ -92,35 +159,41 @@ class MeshTriangle : public Object {
         Vector3f max_vert = Vector3f{-std::numeric_limits<float>::infinity(),
                                      -std::numeric_limits<float>::infinity(),
                                      -std::numeric_limits<float>::infinity()};
-        for (int i = 0; i < mesh.Vertices.size(); i += 3) {
-            std::array<Vector3f, 3> face_vertices;
-
-            for (int j = 0; j < 3; j++) {
-                auto vert =
-                    Vector3f(mesh.Vertices[i + j].Position.X, mesh.Vertices[i + j].Position.Y,
-                             mesh.Vertices[i + j].Position.Z);
-                face_vertices[j] = vert;
-
-                min_vert = Vector3f(std::min(min_vert.x, vert.x), std::min(min_vert.y, vert.y),
-                                    std::min(min_vert.z, vert.z));
-                max_vert = Vector3f(std::max(max_vert.x, vert.x), std::max(max_vert.y, vert.y),
-                                    std::max(max_vert.z, vert.z));
-            }
-
-            triangles.emplace_back(face_vertices[0], face_vertices[1], face_vertices[2], mt);
+        for (uint32_t index : vertexIndex) {
+            const Vector3f& vert = vertices[index];
+            min_vert = Vector3f(std::min(min_vert.x, vert.x), std::min(min_vert.y, vert.y),
+                                std::min(min_vert.z, vert.z));
+            max_vert = Vector3f(std::max(max_vert.x, vert.x), std::max(max_vert.y, vert.y),
+                                std::max(max_vert.z, vert.z));
         }
-
         bounding_box = Bounds3(min_vert, max_vert);
 
-        std::vector<Object*> ptrs;
-        for (auto& tri : triangles) {
-            ptrs.push_back(&tri);
-            area += tri.area;
+        // 构建用的顶点三元组只在构建期间存在
+        std::vector<std::array<Vector3f, 3>> faces(cached ? 0 : numTriangles);
+        areaCdf.reserve(numTriangles);
+        for (uint32_t i = 0; i < numTriangles; ++i) {
+            auto [v0, v1, v2] = triangleVertices(i);
+            areaCdf.push_back(area += crossProduct(v1 - v0, v2 - v0).norm() * 0.5F);
+            if (!cached) { faces[i] = {v0, v1, v2}; }
+        }
+        if (cached) {
+            bvh = std::make_unique<BVHAccel>(this, cache, width, splitMethod, nBuckets, simd);
+            return;
+        }
+        bvh = std::make_unique<BVHAccel>(faces, this, width, splitMethod, nBuckets, simd);
+
+        if (key != 0 && !BVHCache::save(cacheFile, key, *bvh, positions, texCoords, indices)) {
+            fprintf(stderr, "Cannot write BVH cache %s\n", cacheFile.c_str());
         }
-        bvh = new BVHAccel(ptrs);
     }
 
-    auto intersect(const Ray& ray) -> bool { return true; }
+    // 第 i 个三角形的三个顶点
+    auto triangleVertices(uint32_t i) const -> std::array<Vector3f, 3> {
+        return {vertices[vertexIndex[i * 3]], vertices[vertexIndex[i * 3 + 1]],
+                vertices[vertexIndex[i * 3 + 2]]};
+    }
+
+    auto intersect(const Ray& ray) -> bool { return bvh != nullptr && bvh->IntersectP(ray); }
 
     auto intersect(const Ray& ray, float& tnear, uint32_t& index) const -> bool {
         bool intersect = false;
@@ -171,28 +244,81 @@ class MeshTriangle : public Object {
         return intersec;
     }
 
+    auto closestHit(const Ray& ray, HitRecord& hit) -> bool override {
+        return bvh != nullptr && bvh->ClosestHit(ray, hit);
+    }
+
+    // hit.prim 为命中的三角形，法线与 Triangle 的算法相同
+    auto getIntersection(const Ray& ray, const HitRecord& hit) -> Intersection override {
+        auto [v0, v1, v2] = triangleVertices(uint32_t(hit.prim));
+        Intersection inter;
+        inter.happened = true;
+        inter.coords   = ray(hit.t);
+        inter.normal   = normalize(crossProduct(v1 - v0, v2 - v0));
+        inter.distance = hit.t;
+        inter.obj      = this;
+        inter.m        = m;
+        return inter;
+    }
+
+    // 按面积选取一个三角形，再在其上均匀采样
     void Sample(Intersection& pos, float& pdf) {
-        bvh->Sample(pos, pdf);
-        pos.emit = m->getEmission();
+        float p   = get_random_float() * areaCdf.back();
+        auto  idx = std::min(size_t(std::upper_bound(areaCdf.begin(), areaCdf.end(), p) -
+                                    areaCdf.begin()),
+                             areaCdf.size() - 1);
+        auto [v0, v1, v2] = triangleVertices(uint32_t(idx));
+        float x           = std::sqrt(get_random_float());
+        float y           = get_random_float();
+        pos.coords        = v0 * (1.0F - x) + v1 * (x * (1.0F - y)) + v2 * (x * y);
+        pos.normal        = normalize(crossProduct(v1 - v0, v2 - v0));
+        pos.emit          = m->getEmission();
+        pdf               = 1.0F / area;
     }
     auto getArea() -> float { return area; }
     auto hasEmit() -> bool { return m->hasEmission(); }
+    void getEmissiveTriangles(std::vector<EmissiveTriangle>& out) {
+        if (!m->hasEmission()) { return; }
+        for (uint32_t i = 0; i < numTriangles; ++i) {
+            auto [v0, v1, v2] = triangleVertices(i);
+            Vector3f e1       = v1 - v0;
+            Vector3f e2       = v2 - v0;
+            out.push_back({v0, e1, e2, normalize(crossProduct(e1, e2)), m->getEmission(),
+                           crossProduct(e1, e2).norm() * 0.5F});
+        }
+    }
 
-    Bounds3                     bounding_box;
-    std::unique_ptr<Vector3f[]> vertices;
-    uint32_t                    numTriangles;
-    std::unique_ptr<uint32_t[]> vertexIndex;
-    std::unique_ptr<Vector2f[]> stCoordinates;
-
-    std::vector<Triangle> triangles;
+    Bounds3               bounding_box;
+    std::vector<Vector3f> vertices; // 去重后的顶点
+    uint32_t              numTriangles = 0;
+    std::vector<uint32_t> vertexIndex;   // 每三个构成一个三角形
+    std::vector<Vector2f> stCoordinates; // 与 vertices 一一对应，没有纹理坐标时为 0
+    std::vector<float>    areaCdf;       // 按三角形顺序累加的面积
 
-    BVHAccel* bvh;
-    float     area;
+    std::unique_ptr<BVHAccel> bvh;
+    float                     area;
 
     Material* m;
 };
 
-inline auto Triangle::intersect(const Ray& ray) -> bool { return true; }
+// 遮挡查询：只判断 [t_min, t_max) 内是否存在交点，不构造 Intersection
+inline auto Triangle::intersect(const Ray& ray) -> bool {
+    if (dotProduct(ray.direction, normal) > 0) { return false; }
+    Vector3f pvec = crossProduct(ray.direction, e2);
+    float    det  = dotProduct(e1, pvec);
+    if (std::fabs(det) < EPSILON) { return false; }
+
+    float    det_inv = 1.F / det;
+    Vector3f tvec    = ray.origin - v0;
+    float    u       = dotProduct(tvec, pvec) * det_inv;
+    if (u < 0 || u > 1) { return false; }
+    Vector3f qvec = crossProduct(tvec, e1);
+    float    v    = dotProduct(ray.direction, qvec) * det_inv;
+    if (v < 0 || u + v > 1) { return false; }
+    float t = dotProduct(e2, qvec) * det_inv;
+
+    return t >= ray.t_min && t < ray.t_max;
+}
 inline auto Triangle::intersect(const Ray& ray, float& tnear, uint32_t& index) const -> bool {
     return false;
 }
@@ -200,33 +326,42 @@ inline auto Triangle::intersect(const Ray& ray, float& tnear, uint32_t& index) c
 inline auto Triangle::getBounds() -> Bounds3 { return Union(Bounds3(v0, v1), v2); }
 
 inline auto Triangle::getIntersection(Ray ray) -> Intersection {
-    Intersection inter;
+    // DONE find ray triangle intersection
+    HitRecord hit;
+    if (!closestHit(ray, hit)) { return {}; }
+    return getIntersection(ray, hit);
+}
 
-    if (dotProduct(ray.direction, normal) > 0) { return inter; }
-    double   u;
-    double   v;
-    double   t_tmp = 0;
-    Vector3f pvec  = crossProduct(ray.direction, e2);
-    double   det   = dotProduct(e1, pvec);
-    if (fabs(det) < EPSILON) { return inter; }
+// 与 SIMD 三角形块相同的 Möller–Trumbore（剔除背面），只写入精简的命中记录
+inline auto Triangle::closestHit(const Ray& ray, HitRecord& hit) -> bool {
+    Vector3f pvec = crossProduct(ray.direction, e2);
+    float    det  = dotProduct(e1, pvec);
+    if (!(det >= EPSILON)) { return false; }
 
-    double   det_inv = 1. / det;
+    float    det_inv = 1.F / det;
     Vector3f tvec    = ray.origin - v0;
-    u                = dotProduct(tvec, pvec) * det_inv;
-    if (u < 0 || u > 1) { return inter; }
+    float    u       = dotProduct(tvec, pvec) * det_inv;
+    if (u < 0 || u > 1) { return false; }
     Vector3f qvec = crossProduct(tvec, e1);
-    v             = dotProduct(ray.direction, qvec) * det_inv;
-    if (v < 0 || u + v > 1) { return inter; }
-    t_tmp = dotProduct(e2, qvec) * det_inv;
+    float    v    = dotProduct(ray.direction, qvec) * det_inv;
+    if (v < 0 || u + v > 1) { return false; }
+    float t = dotProduct(e2, qvec) * det_inv;
+    if (!(t >= ray.t_min && t < std::min(ray.t_max, hit.t))) { return false; }
+
+    hit.t      = t;
+    hit.uv     = Vector2f(u, v);
+    hit.object = this;
+    return true;
+}
 
-    // DONE find ray triangle intersection
-    inter.happened = true;       // 有交点
-    inter.coords   = ray(t_tmp); // 交点即ray 在t_tmp 时刻的位置;
+inline auto Triangle::getIntersection(const Ray& ray, const HitRecord& hit) -> Intersection {
+    Intersection inter;
+    inter.happened = true;        // 有交点
+    inter.coords   = ray(hit.t);  // 交点即 ray 在 t 时刻的位置
     inter.normal   = this->normal;
-    inter.distance = dotProduct(t_tmp * ray.direction, t_tmp * ray.direction);
-    inter.obj      = this;    // 指向当前对象
-    inter.m        = this->m; // 材质
-
+    inter.distance = hit.t;       // 交点处光线的参数 t
+    inter.obj      = this;        // 指向当前对象
+    inter.m        = this->m;     // 材质
     return inter;
 }
 
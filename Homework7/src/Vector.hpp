@@ -18,8 +18,8 @@ class Vector3f {
     auto operator*(const float& r) const -> Vector3f { return {x * r, y * r, z * r}; }
     auto operator/(const float& r) const -> Vector3f { return {x / r, y / r, z / r}; }
 
-    auto norm() -> float { return std::sqrt(x * x + y * y + z * z); }
-    auto normalized() -> Vector3f {
+    auto norm() const -> float { return std::sqrt(x * x + y * y + z * z); }
+    auto normalized() const -> Vector3f {
         float n = std::sqrt(x * x + y * y + z * z);
         return {x / n, y / n, z / n};
     }
@@ -39,7 +39,7 @@ class Vector3f {
         return os << v.x << ", " << v.y << ", " << v.z;
     }
     auto operator[](int index) const -> double;
-    auto operator[](int index) -> double&;
+    auto operator[](int index) -> float&;
 
     static auto Min(const Vector3f& p1, const Vector3f& p2) -> Vector3f {
         return {std::min(p1.x, p2.x), std::min(p1.y, p2.y), std::min(p1.z, p2.z)};
@@ -50,6 +50,7 @@ class Vector3f {
     }
 };
 inline auto Vector3f::operator[](int index) const -> double { return (&x)[index]; }
+inline auto Vector3f::operator[](int index) -> float& { return (&x)[index]; }
 
 class Vector2f {
   public:
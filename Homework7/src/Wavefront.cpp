@@ -0,0 +1,112 @@
+#include "Wavefront.hpp"
+#include "omp.h"
+#include <algorithm>
+
+auto WavefrontIntegrator::trace(const std::vector<Ray>& cameraRays, std::vector<Sampler>& samplers)
+    -> const std::vector<Vector3f>& {
+    auto nPaths = uint32_t(cameraRays.size());
+    beta_.assign(nPaths, Vector3f(1.0F));
+    L_.assign(nPaths, Vector3f(0.0F));
+    wo_.resize(nPaths);
+    bounce_.assign(nPaths, 0);
+    origin_.resize(nPaths);
+    bsdfPdf_.resize(nPaths);
+    for (auto& queue : rays_) { queue.reserve(nPaths); }
+    shadow_.reserve(nPaths);
+    hits_.resize(nPaths);
+    order_.reserve(nPaths);
+
+    // 生成相机光线
+    for (uint32_t p = 0; p < nPaths; ++p) {
+        rays_[0].push(cameraRays[p], p);
+        wo_[p] = cameraRays[p].direction;
+    }
+
+    for (int cur = 0; rays_[cur].size() > 0; cur ^= 1) {
+        RayQueue& rays = rays_[cur];
+        RayQueue& next = rays_[cur ^ 1];
+        next.count     = 0;
+        shadow_.count  = 0;
+
+        intersectStage(rays);
+        sortStage(rays);
+        shadeStage(rays, next, samplers);
+        shadowStage();
+    }
+    return L_;
+}
+
+void WavefrontIntegrator::intersectStage(const RayQueue& rays) {
+    auto n = int(rays.size());
+#pragma omp parallel for num_threads(nThreads_) schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i) { hits_[i] = scene_.intersect(rays.ray(i)); }
+}
+
+void WavefrontIntegrator::sortStage(const RayQueue& rays) {
+    order_.clear();
+    for (uint32_t i = 0; i < rays.size(); ++i) {
+        const Intersection& x = hits_[i];
+        uint32_t            p = rays.path[i];
+        if (!x.happened) { continue; }
+        if (bounce_[p] == 0) {
+            // 自身发光只在相机直接看到时计入
+            L_[p] += x.m->getEmission();
+        } else if (x.m->hasEmission()) {
+            // 打到光源：按 MIS 权重计入 BSDF 采样得到的发光，路径到此为止
+            L_[p] += beta_[p] * scene_.emittedMIS(origin_[p], wo_[p], bsdfPdf_[p], x);
+            continue;
+        }
+        order_.push_back(i);
+    }
+
+    // 相同材质的命中连续存放，着色时访问的数据与分支更一致
+    std::stable_sort(order_.begin(), order_.end(), [this](uint32_t a, uint32_t b) {
+        return std::less<Material*>()(hits_[a].m, hits_[b].m);
+    });
+}
+
+void WavefrontIntegrator::shadeStage(const RayQueue& rays, RayQueue& next,
+                                     std::vector<Sampler>& samplers) {
+    auto n = int(order_.size());
+#pragma omp parallel for num_threads(nThreads_) schedule(static, 256)
+    for (int k = 0; k < n; ++k) {
+        uint32_t            i = order_[k];
+        uint32_t            p = rays.path[i];
+        const Intersection& x = hits_[i];
+
+        Sampler& sampler = Sampler::current();
+        sampler          = samplers[p];
+
+        // 直接光照：未被遮挡时由阴影阶段累加
+        bool     capped = scene_.maxDepth >= 0 && bounce_[p] >= scene_.maxDepth;
+        Ray      shadowRay(x.coords, wo_[p]);
+        Vector3f L_dir = scene_.sampleDirect(x, wo_[p], shadowRay, !capped);
+        if (L_dir.x > 0 || L_dir.y > 0 || L_dir.z > 0) {
+            shadow_.push(shadowRay, p, beta_[p] * L_dir);
+        }
+
+        // 间接光照：后续光线进入下一阶段的队列
+        Vector3f wi;
+        Vector3f weight;
+        float    pdf = 0;
+        if (!capped && scene_.sampleBounce(x, wo_[p], wi, weight, pdf)) {
+            beta_[p]    = beta_[p] * weight;
+            wo_[p]      = wi;
+            origin_[p]  = x.coords;
+            bsdfPdf_[p] = pdf;
+            bounce_[p]++;
+            next.push(Ray(x.coords, wi), p);
+        }
+
+        samplers[p] = sampler;
+    }
+}
+
+void WavefrontIntegrator::shadowStage() {
+    auto n = int(shadow_.size());
+    // 每条路径每次弹射至多一条阴影光线，不同线程写入的 L_ 互不相同
+#pragma omp parallel for num_threads(nThreads_) schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i) {
+        if (!scene_.intersectP(shadow_.ray(i))) { L_[shadow_.path[i]] += shadow_.contrib[i]; }
+    }
+}
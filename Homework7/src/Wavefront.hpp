@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Intersection.hpp"
+#include "Ray.hpp"
+#include "Sampler.hpp"
+#include "Scene.hpp"
+#include "Vector.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// 结构体数组 (SoA) 形式的光线队列
+//
+// 容量在每批路径开始前分配好，并行阶段通过原子计数领取槽位入队
+struct RayQueue {
+    std::vector<float>    ox, oy, oz;
+    std::vector<float>    dx, dy, dz;
+    std::vector<float>    tMax;
+    std::vector<uint32_t> path;     // 光线所属的路径
+    std::vector<Vector3f> contrib;  // 阴影光线未被遮挡时给路径带来的贡献
+    std::atomic<uint32_t> count{0}; // 队列中的光线数
+
+    void reserve(size_t capacity) {
+        for (auto* v : {&ox, &oy, &oz, &dx, &dy, &dz, &tMax}) { v->resize(capacity); }
+        path.resize(capacity);
+        contrib.resize(capacity);
+        count = 0;
+    }
+
+    auto size() const -> uint32_t { return count.load(std::memory_order_relaxed); }
+
+    // 线程安全
+    void push(const Ray& ray, uint32_t pathIndex, const Vector3f& c = Vector3f(0.0F)) {
+        uint32_t i = count.fetch_add(1, std::memory_order_relaxed);
+        ox[i]      = ray.origin.x;
+        oy[i]      = ray.origin.y;
+        oz[i]      = ray.origin.z;
+        dx[i]      = ray.direction.x;
+        dy[i]      = ray.direction.y;
+        dz[i]      = ray.direction.z;
+        tMax[i]    = ray.t_max;
+        path[i]    = pathIndex;
+        contrib[i] = c;
+    }
+
+    auto ray(uint32_t i) const -> Ray {
+        Ray r(Vector3f(ox[i], oy[i], oz[i]), Vector3f(dx[i], dy[i], dz[i]));
+        r.t_max = tMax[i];
+        return r;
+    }
+};
+
+// 波前式路径追踪
+//
+// 一次处理一大批相机光线：所有光线先求交，命中按材质排序后成批着色，
+// 着色产生的阴影光线与后续光线分别进入下一阶段的队列，直到所有路径终止。
+// 每条路径拥有自己的随机数流，抽取顺序与 Scene::castRay 一致，结果逐位相同。
+class WavefrontIntegrator {
+  public:
+    WavefrontIntegrator(const Scene& scene, int nThreads) : scene_(scene), nThreads_(nThreads) {}
+
+    // 追踪 cameraRays 中的每条光线，samplers 为对应路径的随机数流，返回各路径的辐射亮度
+    auto trace(const std::vector<Ray>& cameraRays, std::vector<Sampler>& samplers)
+        -> const std::vector<Vector3f>&;
+
+  private:
+    void intersectStage(const RayQueue& rays);
+    void sortStage(const RayQueue& rays);
+    void shadeStage(const RayQueue& rays, RayQueue& next, std::vector<Sampler>& samplers);
+    void shadowStage();
+
+    const Scene& scene_;
+    int          nThreads_;
+
+    // 路径状态
+    std::vector<Vector3f> beta_;    // 吞吐量
+    std::vector<Vector3f> L_;       // 辐射亮度
+    std::vector<Vector3f> wo_;      // 入射方向
+    std::vector<int>      bounce_;  // 弹射次数
+    std::vector<Vector3f> origin_;  // 当前光线的起点
+    std::vector<float>    bsdfPdf_; // 当前光线方向由 BSDF 采样得到的概率密度
+
+    RayQueue                  rays_[2]; // 当前与下一阶段的光线
+    RayQueue                  shadow_;  // 阴影光线
+    std::vector<Intersection> hits_;    // 与当前光线一一对应的交点
+    std::vector<uint32_t>     order_;   // 按材质排序后的着色顺序
+};
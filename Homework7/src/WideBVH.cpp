@@ -0,0 +1,417 @@
+#include "WideBVH.hpp"
+#include "BVH.hpp"
+#include "global.hpp"
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define WIDEBVH_X86
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#    define TARGET_AVX2
+#  else
+#    define TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#endif
+
+auto detectSimdLevel() -> SimdLevel {
+#ifdef WIDEBVH_X86
+#  if defined(_MSC_VER) && !defined(__clang__)
+    // AVX2 需要 CPU 支持，同时操作系统要保存 YMM 寄存器
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx     = (info[2] & (1 << 28)) != 0;
+    if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 5)) != 0) { return SimdLevel::AVX2; }
+    }
+#  else
+    if (__builtin_cpu_supports("avx2")) { return SimdLevel::AVX2; }
+#  endif
+    return SimdLevel::SSE;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+namespace {
+    // 无效孩子的掩码
+    constexpr auto validMask(int count) -> uint32_t { return (1U << count) - 1; }
+
+    // 标量实现，任何平台可用。NaN 放在 std::max/min 的第二个参数以被忽略
+    template <int N>
+    auto slabTestScalar(const WideBVHNode<N>& node, const WideRay& ray, float tMax, float* tNear)
+        -> uint32_t {
+        uint32_t mask = 0;
+        for (int i = 0; i < N; ++i) {
+            float t0 = 0.F;
+            float t1 = tMax;
+            for (int a = 0; a < 3; ++a) {
+                t0 = std::max(t0, (node.bounds[ray.nearIdx[a]][i] - ray.org[a]) * ray.invDir[a]);
+                t1 = std::min(t1, (node.bounds[ray.farIdx[a]][i] - ray.org[a]) * ray.invDir[a]);
+            }
+            tNear[i]  = t0;
+            mask     |= uint32_t(t0 <= t1) << i;
+        }
+        return mask & validMask(node.count);
+    }
+
+#ifdef WIDEBVH_X86
+    // SSE：一次测试 4 个孩子。maxps/minps 在有 NaN 时返回第二个操作数
+    auto slabTestSSE(const WideBVHNode<4>& node, const WideRay& ray, float tMax, float* tNear)
+        -> uint32_t {
+        __m128 t0 = _mm_setzero_ps();
+        __m128 t1 = _mm_set1_ps(tMax);
+        for (int a = 0; a < 3; ++a) {
+            __m128 org    = _mm_set1_ps(ray.org[a]);
+            __m128 invDir = _mm_set1_ps(ray.invDir[a]);
+            __m128 tn = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearIdx[a]]), org), invDir);
+            __m128 tf = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.farIdx[a]]), org), invDir);
+            t0        = _mm_max_ps(tn, t0);
+            t1        = _mm_min_ps(tf, t1);
+        }
+        _mm_store_ps(tNear, t0);
+        return uint32_t(_mm_movemask_ps(_mm_cmple_ps(t0, t1))) & validMask(node.count);
+    }
+
+    // AVX2：一次测试 8 个孩子
+    TARGET_AVX2 auto slabTestAVX2(const WideBVHNode<8>& node, const WideRay& ray, float tMax,
+                                  float* tNear) -> uint32_t {
+        __m256 t0 = _mm256_setzero_ps();
+        __m256 t1 = _mm256_set1_ps(tMax);
+        for (int a = 0; a < 3; ++a) {
+            __m256 org    = _mm256_set1_ps(ray.org[a]);
+            __m256 invDir = _mm256_set1_ps(ray.invDir[a]);
+            __m256 tn =
+                _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearIdx[a]]), org), invDir);
+            __m256 tf =
+                _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.farIdx[a]]), org), invDir);
+            t0 = _mm256_max_ps(tn, t0);
+            t1 = _mm256_min_ps(tf, t1);
+        }
+        _mm256_store_ps(tNear, t0);
+        return uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ))) &
+               validMask(node.count);
+    }
+#endif
+
+    // 在 mask 标记的命中通道中选出最近的一个写入 hit
+    template <int N>
+    auto closestLane(uint32_t mask, const float* t, const float* u, const float* v,
+                     const int32_t* prim, TriangleHit& hit) -> bool {
+        bool found = false;
+        while (mask != 0) {
+            int i  = std::countr_zero(mask);
+            mask  &= mask - 1;
+            if (t[i] < hit.t) {
+                hit   = {t[i], prim[i], u[i], v[i]};
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // 与 Triangle::getIntersection 相同的 Möller–Trumbore，剔除背面，空位的边为 0 不会命中
+    template <int N>
+    auto triangleTestScalar(const TriangleBlock<N>& b, const WideRay& ray, float tMin,
+                            TriangleHit& hit) -> bool {
+        alignas(32) float t[N];
+        alignas(32) float u[N];
+        alignas(32) float v[N];
+        uint32_t          mask = 0;
+        for (int i = 0; i < N; ++i) {
+            float px  = ray.dir[1] * b.e2[2][i] - ray.dir[2] * b.e2[1][i];
+            float py  = ray.dir[2] * b.e2[0][i] - ray.dir[0] * b.e2[2][i];
+            float pz  = ray.dir[0] * b.e2[1][i] - ray.dir[1] * b.e2[0][i];
+            float det = b.e1[0][i] * px + b.e1[1][i] * py + b.e1[2][i] * pz;
+            if (!(det >= EPSILON)) { continue; }
+            float invDet = 1.F / det;
+            float tx     = ray.org[0] - b.v0[0][i];
+            float ty     = ray.org[1] - b.v0[1][i];
+            float tz     = ray.org[2] - b.v0[2][i];
+            u[i]         = (tx * px + ty * py + tz * pz) * invDet;
+            float qx     = ty * b.e1[2][i] - tz * b.e1[1][i];
+            float qy     = tz * b.e1[0][i] - tx * b.e1[2][i];
+            float qz     = tx * b.e1[1][i] - ty * b.e1[0][i];
+            v[i]         = (ray.dir[0] * qx + ray.dir[1] * qy + ray.dir[2] * qz) * invDet;
+            t[i]         = (b.e2[0][i] * qx + b.e2[1][i] * qy + b.e2[2][i] * qz) * invDet;
+            bool inside  = u[i] >= 0 && u[i] <= 1 && v[i] >= 0 && u[i] + v[i] <= 1;
+            mask        |= uint32_t(inside && t[i] >= tMin && t[i] < hit.t) << i;
+        }
+        return closestLane<N>(mask, t, u, v, b.prim, hit);
+    }
+
+#ifdef WIDEBVH_X86
+    // 运算顺序与标量版本一致，结果逐位相同
+    auto triangleTestSSE(const TriangleBlock<4>& b, const WideRay& ray, float tMin,
+                         TriangleHit& hit) -> bool {
+        __m128 dx  = _mm_set1_ps(ray.dir[0]);
+        __m128 dy  = _mm_set1_ps(ray.dir[1]);
+        __m128 dz  = _mm_set1_ps(ray.dir[2]);
+        __m128 e1x = _mm_load_ps(b.e1[0]);
+        __m128 e1y = _mm_load_ps(b.e1[1]);
+        __m128 e1z = _mm_load_ps(b.e1[2]);
+        __m128 e2x = _mm_load_ps(b.e2[0]);
+        __m128 e2y = _mm_load_ps(b.e2[1]);
+        __m128 e2z = _mm_load_ps(b.e2[2]);
+
+        __m128 px  = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py  = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz  = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                                _mm_mul_ps(e1z, pz));
+        __m128 mask   = _mm_cmpge_ps(det, _mm_set1_ps(EPSILON));
+        if (_mm_movemask_ps(mask) == 0) { return false; }
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.F), det);
+
+        __m128 tx = _mm_sub_ps(_mm_set1_ps(ray.org[0]), _mm_load_ps(b.v0[0]));
+        __m128 ty = _mm_sub_ps(_mm_set1_ps(ray.org[1]), _mm_load_ps(b.v0[1]));
+        __m128 tz = _mm_sub_ps(_mm_set1_ps(ray.org[2]), _mm_load_ps(b.v0[2]));
+        __m128 u  = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)),
+            invDet);
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v  = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)),
+            invDet);
+        __m128 t  = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+            invDet);
+
+        __m128 zero = _mm_setzero_ps();
+        __m128 one  = _mm_set1_ps(1.F);
+        mask        = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+        mask        = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero),
+                                                  _mm_cmple_ps(_mm_add_ps(u, v), one)));
+        mask        = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, _mm_set1_ps(tMin)),
+                                                  _mm_cmplt_ps(t, _mm_set1_ps(hit.t))));
+        auto bits   = uint32_t(_mm_movemask_ps(mask));
+        if (bits == 0) { return false; }
+
+        alignas(16) float tl[4];
+        alignas(16) float ul[4];
+        alignas(16) float vl[4];
+        _mm_store_ps(tl, t);
+        _mm_store_ps(ul, u);
+        _mm_store_ps(vl, v);
+        return closestLane<4>(bits, tl, ul, vl, b.prim, hit);
+    }
+
+    TARGET_AVX2 auto triangleTestAVX2(const TriangleBlock<8>& b, const WideRay& ray, float tMin,
+                                      TriangleHit& hit) -> bool {
+        __m256 dx  = _mm256_set1_ps(ray.dir[0]);
+        __m256 dy  = _mm256_set1_ps(ray.dir[1]);
+        __m256 dz  = _mm256_set1_ps(ray.dir[2]);
+        __m256 e1x = _mm256_load_ps(b.e1[0]);
+        __m256 e1y = _mm256_load_ps(b.e1[1]);
+        __m256 e1z = _mm256_load_ps(b.e1[2]);
+        __m256 e2x = _mm256_load_ps(b.e2[0]);
+        __m256 e2y = _mm256_load_ps(b.e2[1]);
+        __m256 e2z = _mm256_load_ps(b.e2[2]);
+
+        __m256 px  = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py  = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz  = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                                   _mm256_mul_ps(e1z, pz));
+        __m256 mask   = _mm256_cmp_ps(det, _mm256_set1_ps(EPSILON), _CMP_GE_OQ);
+        if (_mm256_movemask_ps(mask) == 0) { return false; }
+        __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.F), det);
+
+        __m256 tx = _mm256_sub_ps(_mm256_set1_ps(ray.org[0]), _mm256_load_ps(b.v0[0]));
+        __m256 ty = _mm256_sub_ps(_mm256_set1_ps(ray.org[1]), _mm256_load_ps(b.v0[1]));
+        __m256 tz = _mm256_sub_ps(_mm256_set1_ps(ray.org[2]), _mm256_load_ps(b.v0[2]));
+        __m256 u  = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px),
+                                                              _mm256_mul_ps(ty, py)),
+                                                _mm256_mul_ps(tz, pz)),
+                                  invDet);
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+        __m256 v  = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx),
+                                                              _mm256_mul_ps(dy, qy)),
+                                                _mm256_mul_ps(dz, qz)),
+                                  invDet);
+        __m256 t  = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx),
+                                                              _mm256_mul_ps(e2y, qy)),
+                                                _mm256_mul_ps(e2z, qz)),
+                                  invDet);
+
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one  = _mm256_set1_ps(1.F);
+        mask        = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                        _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+        mask        = _mm256_and_ps(
+            mask, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+        mask        = _mm256_and_ps(
+            mask, _mm256_and_ps(_mm256_cmp_ps(t, _mm256_set1_ps(tMin), _CMP_GE_OQ),
+                                _mm256_cmp_ps(t, _mm256_set1_ps(hit.t), _CMP_LT_OQ)));
+        auto bits   = uint32_t(_mm256_movemask_ps(mask));
+        if (bits == 0) { return false; }
+
+        alignas(32) float tl[8];
+        alignas(32) float ul[8];
+        alignas(32) float vl[8];
+        _mm256_store_ps(tl, t);
+        _mm256_store_ps(ul, u);
+        _mm256_store_ps(vl, v);
+        return closestLane<8>(bits, tl, ul, vl, b.prim, hit);
+    }
+#endif
+
+    template <int N> auto selectSlabTest(SimdLevel level) -> SlabTestFn<N> {
+#ifdef WIDEBVH_X86
+        if constexpr (N == 4) {
+            if (level >= SimdLevel::SSE) { return slabTestSSE; }
+        } else if constexpr (N == 8) {
+            if (level >= SimdLevel::AVX2) { return slabTestAVX2; }
+        }
+#endif
+        (void)level;
+        return slabTestScalar<N>;
+    }
+
+    template <int N> auto selectTriangleTest(SimdLevel level) -> TriangleTestFn<N> {
+#ifdef WIDEBVH_X86
+        if constexpr (N == 4) {
+            if (level >= SimdLevel::SSE) { return triangleTestSSE; }
+        } else if constexpr (N == 8) {
+            if (level >= SimdLevel::AVX2) { return triangleTestAVX2; }
+        }
+#endif
+        (void)level;
+        return triangleTestScalar<N>;
+    }
+} // namespace
+
+template <int N>
+WideBVH<N>::WideBVH(const std::vector<LinearBVHNode>& binary, SimdLevel level)
+    : slabTest_(selectSlabTest<N>(level)), triangleTest_(selectTriangleTest<N>(level)) {
+    if (binary.empty()) { return; }
+    ownNodes_.reserve(binary.size() / (N - 1) + 1);
+    collapse(binary, 0);
+    nodes_ = ownNodes_;
+}
+
+template <int N>
+WideBVH<N>::WideBVH(std::span<const WideBVHNode<N>> nodes,
+                    std::span<const TriangleBlock<N>> blocks, SimdLevel level,
+                    std::shared_ptr<const void> storage)
+    : nodes_(nodes), blocks_(blocks), storage_(std::move(storage)),
+      slabTest_(selectSlabTest<N>(level)), triangleTest_(selectTriangleTest<N>(level)) {}
+
+template <int N>
+auto WideBVH<N>::collapse(const std::vector<LinearBVHNode>& binary, int index) -> int {
+    // 从二叉节点 index 的两个孩子开始，反复展开表面积最大的内部孩子，直到凑满 N 个
+    std::vector<int> children;
+    if (binary[index].nPrimitives > 0) {
+        children = {index};
+    } else {
+        children = {index + 1, binary[index].secondChildOffset};
+    }
+    while (children.size() < N) {
+        int   best     = -1;
+        float bestArea = -1;
+        for (int i = 0; i < int(children.size()); ++i) {
+            const LinearBVHNode& c = binary[children[i]];
+            if (c.nPrimitives == 0 && c.bounds.SurfaceArea() > bestArea) {
+                best     = i;
+                bestArea = float(c.bounds.SurfaceArea());
+            }
+        }
+        if (best < 0) { break; }
+        int expand     = children[best];
+        children[best] = expand + 1;
+        children.push_back(binary[expand].secondChildOffset);
+    }
+
+    int            wideIndex = int(ownNodes_.size());
+    WideBVHNode<N> node{};
+    // 空位的包围盒为空集，任何光线都不会命中
+    for (int a = 0; a < 3; ++a) {
+        std::fill_n(node.bounds[a], N, std::numeric_limits<float>::infinity());
+        std::fill_n(node.bounds[a + 3], N, -std::numeric_limits<float>::infinity());
+    }
+    node.count = uint8_t(children.size());
+    for (int i = 0; i < int(children.size()); ++i) {
+        const LinearBVHNode& c = binary[children[i]];
+        for (int a = 0; a < 3; ++a) {
+            node.bounds[a][i]     = c.bounds.pMin[a];
+            node.bounds[a + 3][i] = c.bounds.pMax[a];
+        }
+        node.child[i]  = c.nPrimitives > 0 ? c.primitivesOffset : -1;
+        node.nPrims[i] = c.nPrimitives;
+    }
+    ownNodes_.push_back(node);
+
+    // 递归处理内部孩子；ownNodes_ 可能扩容，因此不持有引用
+    for (int i = 0; i < int(children.size()); ++i) {
+        if (binary[children[i]].nPrimitives == 0) {
+            int childIndex                = collapse(binary, children[i]);
+            ownNodes_[wideIndex].child[i] = childIndex;
+        }
+    }
+    return wideIndex;
+}
+
+template <int N>
+void WideBVH<N>::packTriangles(const std::vector<std::array<Vector3f, 3>>& vertices,
+                               std::span<const int32_t>                    ids) {
+    // 先统计块数，避免逐块追加时反复扩容复制
+    size_t nBlocks = 0;
+    for (const auto& node : ownNodes_) {
+        for (int i = 0; i < node.count; ++i) { nBlocks += (node.nPrims[i] + N - 1) / N; }
+    }
+    ownBlocks_.clear();
+    ownBlocks_.reserve(nBlocks);
+    for (auto& node : ownNodes_) {
+        for (int i = 0; i < node.count; ++i) {
+            if (node.nPrims[i] == 0) { continue; }
+            int first     = node.child[i];
+            node.child[i] = int32_t(ownBlocks_.size());
+            for (int k = 0; k < node.nPrims[i]; k += N) {
+                TriangleBlock<N> block{};
+                std::fill_n(block.prim, N, -1);
+                for (int j = 0; j < N && k + j < node.nPrims[i]; ++j) {
+                    int                            prim = first + k + j;
+                    const std::array<Vector3f, 3>& v    = vertices[prim];
+                    Vector3f                       e1   = v[1] - v[0];
+                    Vector3f                       e2   = v[2] - v[0];
+                    for (int a = 0; a < 3; ++a) {
+                        block.v0[a][j] = v[0][a];
+                        block.e1[a][j] = e1[a];
+                        block.e2[a][j] = e2[a];
+                    }
+                    block.prim[j] = ids.empty() ? prim : ids[prim];
+                }
+                ownBlocks_.push_back(block);
+            }
+        }
+    }
+    blocks_ = ownBlocks_;
+}
+
+template <int N>
+auto WideBVH<N>::intersectTriangles(const Ray& ray, float tMin, bool anyHit,
+                                    TriangleHit& hit) const -> bool {
+    WideRay wideRay(ray);
+    return traverse(wideRay, hit.t, anyHit, [&](int first, int nPrims, float& tMax) {
+        bool found = false;
+        for (int b = first; b < first + (nPrims + N - 1) / N; ++b) {
+            if (triangleTest_(blocks_[b], wideRay, tMin, hit)) {
+                found = true;
+                tMax  = hit.t;
+                if (anyHit) { break; }
+            }
+        }
+        return found;
+    });
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Ray.hpp"
+#include "Vector.hpp"
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct LinearBVHNode;
+
+// SIMD 指令集级别
+enum class SimdLevel { SCALAR, SSE, AVX2 };
+
+// 运行时检测 CPU 支持的最高级别
+auto detectSimdLevel() -> SimdLevel;
+// level 下多叉 BVH 的宽度，也是一个三角形块中的三角形数
+inline auto simdWidth(SimdLevel level) -> int { return level == SimdLevel::AVX2 ? 8 : 4; }
+
+// N 叉 BVH 节点：N 个孩子的包围盒按 SoA 存放，一次访问用 SIMD 同时测试所有孩子
+template <int N> struct alignas(32) WideBVHNode {
+    float    bounds[6][N]; // pMin.x, pMin.y, pMin.z, pMax.x, pMax.y, pMax.z
+    int32_t  child[N];     // 内部节点为子节点下标，叶子为图元起始下标
+    uint16_t nPrims[N];    // 叶子中的图元数，内部节点为 0
+    uint8_t  count;        // 有效孩子数
+};
+
+// 叶子中的三角形按 SoA 打包，边预先算好
+template <int N> struct alignas(32) TriangleBlock {
+    float   v0[3][N];
+    float   e1[3][N]; // v1 - v0
+    float   e2[3][N]; // v2 - v0
+    int32_t prim[N];  // 三角形的编号，空位为 -1
+};
+
+// 精简的命中记录，完整的表面信息只对最终的最近交点计算
+struct TriangleHit {
+    float   t    = std::numeric_limits<float>::infinity();
+    int32_t prim = -1;
+    float   u    = 0;
+    float   v    = 0;
+};
+
+// 节点测试所需的光线数据，按方向符号预先选好进入面与离开面
+struct WideRay {
+    explicit WideRay(const Ray& ray) {
+        for (int a = 0; a < 3; ++a) {
+            org[a]     = ray.origin[a];
+            dir[a]     = ray.direction[a];
+            invDir[a]  = ray.direction_inv[a];
+            int isNeg  = ray.direction[a] < 0 ? 1 : 0;
+            nearIdx[a] = isNeg * 3 + a;
+            farIdx[a]  = (1 - isNeg) * 3 + a;
+        }
+    }
+    float org[3];
+    float dir[3];
+    float invDir[3];
+    int   nearIdx[3];
+    int   farIdx[3];
+};
+
+// 测试节点的所有孩子，返回命中孩子的位掩码，tNear 写入各孩子的进入距离
+template <int N>
+using SlabTestFn = uint32_t (*)(const WideBVHNode<N>& node, const WideRay& ray, float tMax,
+                                float* tNear);
+
+// 与块中的三角形求交，只接受 [tMin, hit.t) 内的交点，命中时更新 hit 为其中最近的一个
+template <int N>
+using TriangleTestFn = bool (*)(const TriangleBlock<N>& block, const WideRay& ray, float tMin,
+                                TriangleHit& hit);
+
+// 由二叉 BVH 合并得到的 N 叉 BVH
+template <int N> class WideBVH {
+  public:
+    WideBVH(const std::vector<LinearBVHNode>& binary, SimdLevel level);
+    // 直接使用已经构建好的节点与三角形块（例如映射到内存中的缓存文件），
+    // storage 持有它们所在的内存
+    WideBVH(std::span<const WideBVHNode<N>> nodes, std::span<const TriangleBlock<N>> blocks,
+            SimdLevel level, std::shared_ptr<const void> storage);
+    // 遍历数据可能指向自身的成员，不能复制
+    WideBVH(const WideBVH&)                    = delete;
+    auto operator=(const WideBVH&) -> WideBVH& = delete;
+
+    // 遍历与光线相交的叶子，最近的孩子先访问，进入距离超过 tMax 的节点被跳过。
+    // leaf(primOffset, nPrims, tMax) 与叶子中的图元求交，命中时缩小 tMax 并返回 true；
+    // anyHit 为 true 时遇到第一个命中即返回
+    template <typename LeafFn>
+    auto traverse(const WideRay& ray, float tMax, bool anyHit, LeafFn&& leaf) const -> bool;
+
+    // 把三角形按叶子打包成 SoA 块，vertices 按图元顺序给出各三角形的顶点。
+    // 打包后叶子的 child 指向第一个块，叶子中的图元依次占用 ceil(nPrims / N) 个块。
+    // 块中记录的编号为 ids[图元下标]，ids 为空时就是图元下标
+    void packTriangles(const std::vector<std::array<Vector3f, 3>>& vertices,
+                       std::span<const int32_t> ids = {});
+    auto hasTriangles() const -> bool { return !blocks_.empty(); }
+    // 与打包的三角形求交，hit.t 传入时为搜索上限
+    auto intersectTriangles(const Ray& ray, float tMin, bool anyHit, TriangleHit& hit) const
+        -> bool;
+
+    auto nodeCount() const -> size_t { return nodes_.size(); }
+    auto nodes() const -> std::span<const WideBVHNode<N>> { return nodes_; }
+    auto blocks() const -> std::span<const TriangleBlock<N>> { return blocks_; }
+
+  private:
+    auto collapse(const std::vector<LinearBVHNode>& binary, int index) -> int;
+
+    // 自行构建时的存储
+    std::vector<WideBVHNode<N>>   ownNodes_;
+    std::vector<TriangleBlock<N>> ownBlocks_;
+    // 遍历使用的数据，指向上面的数组或 storage_ 中的内存
+    std::span<const WideBVHNode<N>>   nodes_;
+    std::span<const TriangleBlock<N>> blocks_;
+    std::shared_ptr<const void>       storage_;
+    SlabTestFn<N>                     slabTest_;
+    TriangleTestFn<N>                 triangleTest_;
+};
+
+template <int N>
+template <typename LeafFn>
+auto WideBVH<N>::traverse(const WideRay& ray, float tMax, bool anyHit, LeafFn&& leaf) const
+    -> bool {
+    if (nodes_.empty()) { return false; }
+
+    struct Entry {
+        int32_t  index;
+        uint16_t nPrims; // 大于 0 时表示叶子
+        float    t;      // 进入距离
+    };
+    std::array<Entry, 64 * N> stack;
+    int                       sp = 0;
+    stack[sp++]                  = {0, 0, 0.F};
+
+    bool hit = false;
+    while (sp > 0) {
+        Entry e = stack[--sp];
+        if (e.t > tMax) { continue; }
+        if (e.nPrims > 0) {
+            if (leaf(int(e.index), int(e.nPrims), tMax)) {
+                hit = true;
+                if (anyHit) { return true; }
+            }
+            continue;
+        }
+
+        const WideBVHNode<N>& node = nodes_[e.index];
+        alignas(32) float     tNear[N];
+        uint32_t              mask = slabTest_(node, ray, tMax, tNear);
+
+        // 命中的孩子按进入距离从远到近入栈，最近的最先出栈
+        int first = sp;
+        while (mask != 0) {
+            int   i  = std::countr_zero(mask);
+            mask    &= mask - 1;
+            Entry c{node.child[i], node.nPrims[i], tNear[i]};
+            int   k = sp++;
+            while (k > first && stack[k - 1].t < c.t) {
+                stack[k] = stack[k - 1];
+                --k;
+            }
+            stack[k] = c;
+        }
+    }
+    return hit;
+}
@@ -1,7 +1,8 @@
 #pragma once
+#include "Sampler.hpp"
 #include <cmath>
 #include <iostream>
-#include <random>
+#include <limits>
 
 #undef M_PI
 #define M_PI 3.141592653589793F
@@ -28,13 +29,8 @@ inline auto solveQuadratic(const float& a, const float& b, const float& c, float
     return true;
 }
 
-inline auto get_random_float() -> float {
-    static std::random_device                    dev;
-    static std::mt19937                          rng(dev());
-    static std::uniform_real_distribution<float> dist(0.F, 1.F); // distribution in range [1, 6]
-
-    return dist(rng);
-}
+// 从当前线程的随机数流中取下一个 [0, 1) 内的随机数
+inline auto get_random_float() -> float { return Sampler::current().get1D(); }
 
 inline void UpdateProgress(float progress) {
     int barWidth = 36;
@@ -0,0 +1,30 @@
+// 把 OBJ 网格转换为可以直接映射的二进制网格文件（.mesh）
+//
+// 用法：meshconv input.obj [output.mesh]，省略输出时与输入同名。
+// 文件中的全部网格合并为一个，相同的顶点（v/vt/vn 组合相同）只保存一次。
+
+#include "MeshFile.hpp"
+#include "ObjParser.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+auto main(int argc, char** argv) -> int {
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage: %s input.obj [output.mesh]\n", argv[0]);
+        return 1;
+    }
+    std::string input  = argv[1];
+    std::string output = std::filesystem::path(input).replace_extension(".mesh").string();
+    if (argc == 3) { output = argv[2]; }
+
+    ObjMesh mesh;
+    if (!loadObj(input, mesh)) { return 1; }
+    if (!MeshFile::write(output, mesh.positions, mesh.normals, mesh.texCoords, mesh.indices)) {
+        fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+    printf("%s: %zu triangles, %zu vertices\n", output.c_str(), mesh.triangleCount(),
+           mesh.positions.size());
+    return 0;
+}
@@ -0,0 +1,100 @@
+// 比较 objl::Loader 与 loadObj 读取同一个 OBJ 的耗时，并检查两者得到的三角形是否一致
+//
+// 用法：objbench [input.obj] [--grid N]。没有给出文件时生成一个 N×N 网格
+// （默认 N = 1024，约两百万个三角形，带 vt 与 vn）写到临时目录中再测试。
+
+#include "OBJ_Loader.hpp"
+#include "ObjParser.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+    // 单位正方形上的高度场网格，每个格子两个三角形
+    auto writeGrid(const std::string& filename, int n) -> bool {
+        FILE* fp = fopen(filename.c_str(), "w");
+        if (fp == nullptr) { return false; }
+        fprintf(fp, "# %d x %d grid\n", n, n);
+        for (int y = 0; y <= n; ++y) {
+            for (int x = 0; x <= n; ++x) {
+                float u = float(x) / float(n);
+                float v = float(y) / float(n);
+                fprintf(fp, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0 1 0\n", u, 0.1 * u * v, v, u, v);
+            }
+        }
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                int a = y * (n + 1) + x + 1;
+                int b = a + 1;
+                int c = a + n + 1;
+                int d = c + 1;
+                fprintf(fp, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, d, d, d);
+                fprintf(fp, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, d, d, d, c, c, c);
+            }
+        }
+        return fclose(fp) == 0;
+    }
+
+    template <typename F> auto measure(F&& f) -> double {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+    }
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    std::string input;
+    int         grid = 1024;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view(argv[i]) == "--grid" && i + 1 < argc) {
+            grid = std::atoi(argv[++i]);
+        } else {
+            input = argv[i];
+        }
+    }
+    if (input.empty()) {
+        input = (std::filesystem::temp_directory_path() / "objbench_grid.obj").string();
+        printf("Writing %d x %d grid to %s\n", grid, grid, input.c_str());
+        if (!writeGrid(input, grid)) {
+            fprintf(stderr, "Cannot write %s\n", input.c_str());
+            return 1;
+        }
+    }
+
+    objl::Loader loader;
+    double       objlTime      = measure([&] { loader.LoadFile(input); });
+    size_t       objlTriangles = 0;
+    for (const auto& mesh : loader.LoadedMeshes) { objlTriangles += mesh.Indices.size() / 3; }
+    printf("objl::Loader        : %10.1f ms, %zu triangles\n", objlTime, objlTriangles);
+
+    int     nThreads = int(std::max(1U, std::thread::hardware_concurrency()));
+    ObjMesh single;
+    ObjMesh parallel;
+    double  singleTime   = measure([&] { loadObj(input, single, 1); });
+    double  parallelTime = measure([&] { loadObj(input, parallel, nThreads); });
+    printf("loadObj, 1 thread   : %10.1f ms, %zu triangles, %.1fx\n", singleTime,
+           single.triangleCount(), objlTime / singleTime);
+    printf("loadObj, %2d threads : %10.1f ms, %zu triangles, %.1fx\n", nThreads, parallelTime,
+           parallel.triangleCount(), objlTime / parallelTime);
+
+    // 逐个角点比较位置。多边形的三角化方式不同（objl 剪耳，loadObj 扇形），
+    // 含多边形的文件会有不一致的角点
+    size_t mismatches = 0;
+    size_t corner     = 0;
+    for (const auto& mesh : loader.LoadedMeshes) {
+        for (unsigned int index : mesh.Indices) {
+            if (corner >= parallel.indices.size()) { break; }
+            const auto& a = mesh.Vertices[index].Position;
+            const auto& b = parallel.positions[parallel.indices[corner++]];
+            mismatches   += a.X != b.x || a.Y != b.y || a.Z != b.z;
+        }
+    }
+    printf("%zu of %zu corners differ\n", mismatches, corner);
+    return 0;
+}
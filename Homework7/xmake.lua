@@ -28,9 +28,41 @@ target("07", function()
     set_extension(".exe")
     set_default(true)
     add_files("src/*.cpp")
+    -- 各作业共用的网格文件读写
+    add_files("../Common/*.cpp")
+    add_includedirs("../Common")
 
     add_packages("openmp")
+    if is_plat("windows") then
+        add_syslinks("ws2_32") -- 渲染服务器使用的 Winsock
+    end
 
     set_rundir("./")
     set_runargs()
 end)
+
+-- OBJ 转换为二进制网格文件的工具
+target("meshconv", function()
+    set_kind("binary")
+    set_extension(".exe")
+    set_default(false)
+    add_files("tools/meshconv.cpp", "../Common/MappedFile.cpp", "src/ObjParser.cpp")
+    add_includedirs("src", "../Common")
+
+    add_packages("openmp")
+
+    set_rundir("./")
+end)
+
+-- OBJ 解析耗时对比：objl::Loader 与 loadObj
+target("objbench", function()
+    set_kind("binary")
+    set_extension(".exe")
+    set_default(false)
+    add_files("tools/objbench.cpp", "../Common/MappedFile.cpp", "src/ObjParser.cpp")
+    add_includedirs("src", "../Common")
+
+    add_packages("openmp")
+
+    set_rundir("./")
+end)